@@ -105,6 +105,7 @@ struct cli;
 struct cli_proto;
 struct director;
 struct iovec;
+struct listen_sock;
 struct mempool;
 struct objcore;
 struct objhead;
@@ -114,6 +115,7 @@ struct transport;
 struct req;
 struct sess;
 struct suckaddr;
+struct ved_plan;
 struct vrt_priv;
 struct vsb;
 struct worker;
@@ -434,6 +436,7 @@ struct objcore {
 	VTAILQ_ENTRY(objcore)	ban_list;
 	VSTAILQ_ENTRY(objcore)	exp_list;
 	struct ban		*ban;
+	struct ved_plan		*esi_plan;
 };
 
 /* Busy Object structure ---------------------------------------------
@@ -480,6 +483,11 @@ struct busyobj {
 
 	struct pool_task	fetch_task;
 
+	/* Body fetch parked on the waiter, see vbf_stp_park() */
+	struct waited		waited[1];
+	unsigned		parked;
+	unsigned		park_timeout;
+
 #define BO_FLAG(l, r, w, d) unsigned	l:1;
 #include "tbl/bo_flags.h"
 
@@ -543,6 +551,8 @@ struct req {
 
 	/* The busy objhead we sleep on */
 	struct objhead		*hash_objhead;
+	/* The object handed to us when it was unbusied */
+	struct objcore		*hash_oc;
 
 	/* Built Vary string */
 	uint8_t			*vary_b;
@@ -554,6 +564,7 @@ struct req {
 	double			d_ttl;
 
 	ssize_t			req_bodybytes;	/* Parsed req bodybytes */
+	ssize_t			req_body_spool;	/* Max req bodybytes to spool */
 	const struct stevedore	*storage;
 
 	const struct director	*director_hint;
@@ -586,6 +597,7 @@ struct req {
 	struct vdp_entry_s	vdp;
 	struct vdp_entry	*vdp_nxt;
 	unsigned		vdp_retval;
+	ssize_t			vdp_off;	/* Body offset to start from */
 
 	/* Delivery mode */
 	unsigned		res_mode;
@@ -596,6 +608,7 @@ struct req {
 #define RES_ESI_CHILD		(1<<5)
 #define RES_GUNZIP		(1<<6)
 #define RES_PIPE		(1<<7)
+#define RES_BROTLI		(1<<8)
 
 	/* Transaction VSL buffer */
 	struct vsl_log		vsl[1];
@@ -642,6 +655,7 @@ struct sess {
 
 	struct vrt_privs	privs[1];
 
+	const struct listen_sock *listen_sock;
 };
 
 /* Prototypes etc ----------------------------------------------------*/
@@ -727,7 +741,7 @@ enum vgzret_e {
 };
 
 enum vgz_flag { VGZ_NORMAL, VGZ_ALIGN, VGZ_RESET, VGZ_FINISH };
-// struct vgz *VGZ_NewUngzip(struct vsl_log *vsl, const char *id);
+struct vgz *VGZ_NewGunzip(struct vsl_log *vsl, const char *id);
 struct vgz *VGZ_NewGzip(struct vsl_log *vsl, const char *id);
 void VGZ_Ibuf(struct vgz *, const void *, ssize_t len);
 int VGZ_IbufEmpty(const struct vgz *vg);
@@ -735,7 +749,7 @@ void VGZ_Obuf(struct vgz *, void *, ssize_t len);
 int VGZ_ObufFull(const struct vgz *vg);
 enum vgzret_e VGZ_Gzip(struct vgz *, const void **, ssize_t *len,
     enum vgz_flag);
-// enum vgzret_e VGZ_Gunzip(struct vgz *, const void **, ssize_t *len);
+enum vgzret_e VGZ_Gunzip(struct vgz *, const void **, ssize_t *len);
 enum vgzret_e VGZ_Destroy(struct vgz **);
 
 enum vgz_ua_e {
@@ -779,6 +793,7 @@ int http_IsStatus(const struct http *hp, int);
 void http_SetStatus(struct http *to, uint16_t status);
 const char *http_GetMethod(const struct http *hp);
 int http_HdrIs(const struct http *hp, const char *hdr, const char *val);
+int http_IsHdr(const txt *hh, const char *hdr);
 void http_CopyHome(const struct http *hp);
 void http_Unset(struct http *hp, const char *hdr);
 unsigned http_CountHdr(const struct http *hp, const char *hdr);
@@ -865,6 +880,11 @@ void ObjDestroy(struct worker *, struct objcore **);
 typedef int objiterate_f(void *priv, int flush, const void *ptr, ssize_t len);
 int ObjIterate(struct worker *, struct objcore *,
     void *priv, objiterate_f *func, int final);
+int ObjIterateOffset(struct worker *, struct objcore *, ssize_t off,
+    void *priv, objiterate_f *func, int final);
+typedef int objsendfile_f(void *priv, int fd, off_t off, ssize_t len);
+int ObjSendfile(struct worker *, struct objcore *,
+    void *priv, objsendfile_f *func);
 int ObjGetSpace(struct worker *, struct objcore *, ssize_t *sz, uint8_t **ptr);
 void ObjExtend(struct worker *, struct objcore *, ssize_t l);
 uint64_t ObjWaitExtend(const struct worker *, const struct objcore *,
@@ -938,6 +958,7 @@ void Req_AcctLogCharge(struct dstat *, struct req *);
 /* cache_req_body.c */
 int VRB_Ignore(struct req *);
 ssize_t VRB_Cache(struct req *, ssize_t maxsize);
+int VRB_Spool(struct req *, ssize_t maxsize);
 ssize_t VRB_Iterate(struct req *, objiterate_f *func, void *priv);
 void VRB_Free(struct req *);
 
@@ -1019,6 +1040,7 @@ void VSL_Flush(struct vsl_log *, int overflow);
 /* cache_vary.c */
 int VRY_Create(struct busyobj *bo, struct vsb **psb);
 int VRY_Match(struct req *, const uint8_t *vary);
+int VRY_MatchAll(const uint8_t *vary);
 void VRY_Prep(struct req *);
 void VRY_Clear(struct req *);
 enum vry_finish_flag { KEEP, DISCARD };
@@ -1080,6 +1102,7 @@ WS_Front(const struct ws *ws)
 void RFC2616_Ttl(struct busyobj *, double now, double *t_origin,
     float *ttl, float *grace, float *keep);
 unsigned RFC2616_Req_Gzip(const struct http *);
+unsigned RFC2616_Req_Br(const struct http *);
 int RFC2616_Do_Cond(const struct req *sp);
 void RFC2616_Weaken_Etag(struct http *hp);
 void RFC2616_Vary_AE(struct http *hp);
@@ -336,6 +336,7 @@ vca_make_session(struct worker *wrk, void *arg)
 	sp->vxid = VXID_Get(wrk, VSL_CLIENTMARKER);
 
 	sp->fd = wa->acceptsock;
+	sp->listen_sock = wa->acceptlsock;
 	wa->acceptsock = -1;
 
 	assert(wa->acceptaddrlen <= vsa_suckaddr_len);
@@ -656,6 +657,7 @@ XPORT_Init(void)
 	VTAILQ_INSERT_TAIL(&transports, &PROXY_transport, list);
 	VTAILQ_INSERT_TAIL(&transports, &HTTP1_transport, list);
 	VTAILQ_INSERT_TAIL(&transports, &H2_transport, list);
+	VTAILQ_INSERT_TAIL(&transports, &KTLS_transport, list);
 
 	n = 0;
 	VTAILQ_FOREACH(xp, &transports, list)
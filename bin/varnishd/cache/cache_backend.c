@@ -32,6 +32,7 @@
 
 #include "config.h"
 
+#include <math.h>
 #include <stdlib.h>
 
 #include "cache.h"
@@ -107,6 +108,10 @@ vbe_dir_getfd(struct worker *wrk, struct backend *bp, struct busyobj *bo)
 	bp->n_conn++;
 	bp->vsc->conn++;
 	bp->vsc->req++;
+	if (vc->recycled)
+		bp->vsc->conn_pooled++;
+	else
+		bp->vsc->conn_new++;
 	Lck_Unlock(&bp->mtx);
 
 	if (bp->proxy_header != 0)
@@ -127,6 +132,53 @@ vbe_dir_getfd(struct worker *wrk, struct backend *bp, struct busyobj *bo)
 	return (vc);
 }
 
+/*--------------------------------------------------------------------
+ * Peak EWMA of the time from sending the request to having the response
+ * headers: a slower sample replaces the average right away, faster ones
+ * pull it down at a rate of one decay time constant.
+ */
+
+static void
+vbe_latency(struct backend *bp, double now, double sample)
+{
+	double w;
+
+	Lck_AssertHeld(&bp->mtx);
+	if (sample >= bp->latency) {
+		bp->latency = sample;
+	} else {
+		w = exp(-(now - bp->t_latency) /
+		    cache_param->backend_latency_decay);
+		bp->latency = bp->latency * w + sample * (1. - w);
+	}
+	bp->t_latency = now;
+}
+
+/*
+ * For directors balancing by load.  This is read without the lock, and
+ * the average keeps decaying without samples, so that a backend which
+ * was slow once gets another chance eventually.
+ */
+
+static unsigned __match_proto__(vdi_load_f)
+vbe_dir_load(const struct director *d, double *latency)
+{
+	struct backend *bp;
+	double lat, t;
+
+	CHECK_OBJ_NOTNULL(d, DIRECTOR_MAGIC);
+	CAST_OBJ_NOTNULL(bp, d->priv, BACKEND_MAGIC);
+	if (latency != NULL) {
+		lat = bp->latency;
+		t = bp->t_latency;
+		if (lat > 0.)
+			lat *= exp(-(VTIM_real() - t) /
+			    cache_param->backend_latency_decay);
+		*latency = lat;
+	}
+	return (bp->n_conn);
+}
+
 static unsigned __match_proto__(vdi_healthy_f)
 vbe_dir_healthy(const struct director *d, const struct busyobj *bo,
     double *changed)
@@ -166,7 +218,7 @@ vbe_dir_finish(const struct director *d, struct worker *wrk,
 		    bp->display_name);
 		Lck_Lock(&bp->mtx);
 		VSC_C_main->backend_recycle++;
-		VBT_Recycle(wrk, bp->tcp_pool, &vbc);
+		VBT_Recycle(wrk, bp->tcp_pool, &vbc, bp->max_idle);
 	}
 	assert(bp->n_conn > 0);
 	bp->n_conn--;
@@ -184,6 +236,7 @@ vbe_dir_gethdrs(const struct director *d, struct worker *wrk,
 	int i, extrachance = 1;
 	struct backend *bp;
 	struct vbc *vbc;
+	double t = 0., now;
 
 	CHECK_OBJ_NOTNULL(d, DIRECTOR_MAGIC);
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
@@ -215,10 +268,16 @@ vbe_dir_gethdrs(const struct director *d, struct worker *wrk,
 
 		assert(vbc->state == VBC_STATE_USED);
 
-		if (i == 0)
+		if (i == 0) {
+			t = W_TIM_real(wrk);
 			i = V1F_FetchRespHdr(bo);
+		}
 		if (i == 0) {
 			AN(bo->htc->priv);
+			now = W_TIM_real(wrk);
+			Lck_Lock(&bp->mtx);
+			vbe_latency(bp, now, now - t);
+			Lck_Unlock(&bp->mtx);
 			return (0);
 		}
 
@@ -334,6 +393,7 @@ vbe_panic(const struct director *d, struct vsb *vsb)
 	VSB_printf(vsb, "admin_health = %s, changed = %f,\n",
 	    bp->admin_health, bp->health_changed);
 	VSB_printf(vsb, "n_conn = %u,\n", bp->n_conn);
+	VSB_printf(vsb, "latency = %f,\n", bp->latency);
 }
 
 /*--------------------------------------------------------------------*/
@@ -352,6 +412,7 @@ VBE_fill_director(struct backend *be)
 	d->vcl_name = be->vcl_name;
 	d->http1pipe = vbe_dir_http1pipe;
 	d->healthy = vbe_dir_healthy;
+	d->load = vbe_dir_load;
 	d->gethdrs = vbe_dir_gethdrs;
 	d->getbody = vbe_dir_getbody;
 	d->getip = vbe_dir_getip;
@@ -41,6 +41,7 @@ struct vbp_target;
 struct vrt_ctx;
 struct vrt_backend_probe;
 struct tcp_pool;
+struct vbt_slot;
 
 /*--------------------------------------------------------------------
  * An instance of a backend from a VCL program.
@@ -51,6 +52,8 @@ struct backend {
 #define BACKEND_MAGIC		0x64c4c7c6
 
 	unsigned		n_conn;
+	double			latency;
+	double			t_latency;
 
 	VTAILQ_ENTRY(backend)	list;
 	VTAILQ_ENTRY(backend)	vcl_list;
@@ -91,8 +94,10 @@ struct vbc {
 #define VBC_STATE_USED		(1<<1)
 #define VBC_STATE_STOLEN	(1<<2)
 #define VBC_STATE_CLEANUP	(1<<3)
+	uint8_t			recycled;
 	struct waited		waited[1];
 	struct tcp_pool		*tcp_pool;
+	struct vbt_slot		*slot;
 
 	pthread_cond_t		*cond;
 };
@@ -123,11 +128,16 @@ struct tcp_pool *VBT_Ref(const struct suckaddr *ip4,
     const struct suckaddr *ip6);
 void VBT_Rel(struct tcp_pool **tpp);
 int VBT_Open(const struct tcp_pool *tp, double tmo, const struct suckaddr **sa);
-void VBT_Recycle(const struct worker *, struct tcp_pool *, struct vbc **);
+int VBT_OpenNext(const struct tcp_pool *tp, double tmo,
+    const struct suckaddr **sa);
+void VBT_Recycle(const struct worker *, struct tcp_pool *, struct vbc **,
+    unsigned max_idle);
+void VBT_Warm(struct tcp_pool *, unsigned min_idle, double tmo);
 void VBT_Close(struct tcp_pool *tp, struct vbc **vbc);
 struct vbc *VBT_Get(struct tcp_pool *, double tmo, const struct backend *,
     struct worker *);
 void VBT_Wait(struct worker *, struct vbc *);
+void VBT_Init(void);
 
 /* cache_vcl.c */
 int VCL_AddBackend(struct vcl *, struct backend *);
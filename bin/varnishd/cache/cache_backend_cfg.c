@@ -430,6 +430,25 @@ static struct cli_proto backend_cmds[] = {
 	{ NULL }
 };
 
+/*---------------------------------------------------------------------
+ * Top up the idle connections of healthy backends with a .min_idle
+ */
+
+static void
+vbe_warm(const struct backend *be)
+{
+	double tmo;
+
+	CHECK_OBJ_NOTNULL(be, BACKEND_MAGIC);
+	if (be->min_idle == 0 || be->proxy_header != 0 || be->vsc == NULL)
+		return;
+	if (!VBE_Healthy(be, NULL))
+		return;
+	tmo = be->connect_timeout > 0. ?
+	    be->connect_timeout : cache_param->connect_timeout;
+	VBT_Warm(be->tcp_pool, be->min_idle, tmo);
+}
+
 /*---------------------------------------------------------------------*/
 
 void
@@ -451,6 +470,8 @@ VBE_Poll(void)
 		VBE_Delete(be);
 		Lck_Lock(&backends_mtx);
 	}
+	VTAILQ_FOREACH(be, &backends, list)
+		vbe_warm(be);
 	Lck_Unlock(&backends_mtx);
 }
 
@@ -462,4 +483,5 @@ VBE_InitCfg(void)
 
 	CLI_AddFuncs(backend_cmds);
 	Lck_New(&backends_mtx, lck_vbe);
+	VBT_Init();
 }
@@ -28,8 +28,12 @@
  *
  * Poll backends for collection of health statistics
  *
- * We co-opt threads from the worker pool for probing the backends,
- * but we want to avoid a potentially messy cleanup operation when we
+ * A single thread runs all the probes, multiplexing their connects,
+ * requests and responses with poll(2), so that a large number of
+ * probed backends neither ties up worker threads nor needs a thread
+ * per probe in flight.
+ *
+ * We want to avoid a potentially messy cleanup operation when we
  * retire the backend, so the thread owns the health information, which
  * the backend references, rather than the other way around.
  *
@@ -39,6 +43,7 @@
 
 #include "cache.h"
 
+#include <errno.h>
 #include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,6 +53,7 @@
 
 #include "binary_heap.h"
 #include "vcli_serve.h"
+#include "vrnd.h"
 #include "vrt.h"
 #include "vsa.h"
 #include "vtcp.h"
@@ -85,11 +91,21 @@ struct vbp_target {
 	double				due;
 	int				running;
 	int				heap_idx;
-	struct pool_task		task;
+
+	/* Owned by the poller thread while running */
+	VTAILQ_ENTRY(vbp_target)	list;
+	int				fd;
+	int				sent;
+	unsigned			rlen;
+	double				t_start;
+	double				t_end;
+	const struct suckaddr		*sa;
 };
 
+VTAILQ_HEAD(vbp_head, vbp_target);
+
 static struct lock			vbp_mtx;
-static pthread_cond_t			vbp_cond;
+static int				vbp_pipe[2];
 static struct binheap			*vbp_heap;
 
 static const unsigned char vbp_proxy_local[] = {
@@ -264,26 +280,40 @@ vbp_write_proxy_v1(struct vbp_target *vt, int *sock)
 	return (vbp_write(vt, sock, VSB_data(&vsb), VSB_len(&vsb)));
 }
 
-static void
-vbp_poke(struct vbp_target *vt)
+/*--------------------------------------------------------------------
+ * The connect failed or timed out, move on to the other address
+ * family if the backend has one, with a fresh timeout.
+ */
+
+static int
+vbp_connect_next(struct vbp_target *vt, double now)
+{
+
+	if (vt->fd >= 0)
+		VTCP_close(&vt->fd);
+	vt->fd = VBT_OpenNext(vt->tcp_pool, -1, &vt->sa);
+	if (vt->fd < 0)
+		return (-1);
+	vt->t_end = now + vt->timeout;
+	return (0);
+}
+
+/*--------------------------------------------------------------------
+ * The connection is up, send the PROXY header and the request.
+ */
+
+static int
+vbp_send(struct vbp_target *vt, double now)
 {
-	int s, tmo, i, proxy_header;
-	double t_start, t_now, t_end;
-	unsigned rlen, resp;
-	char buf[8192], *p;
-	struct pollfd pfda[1], *pfd = pfda;
-	const struct suckaddr *sa;
-
-	t_start = t_now = VTIM_real();
-	t_end = t_start + vt->timeout;
-
-	s = VBT_Open(vt->tcp_pool, t_end - t_now, &sa);
-	if (s < 0) {
-		/* Got no connection: failed */
-		return;
+	int i, proxy_header;
+
+	vt->fd = VTCP_connected(vt->fd);
+	if (vt->fd < 0) {
+		/* Got no connection: try the other address */
+		return (vbp_connect_next(vt, now));
 	}
 
-	i = VSA_Get_Proto(sa);
+	i = VSA_Get_Proto(vt->sa);
 	if (i == AF_INET)
 		vt->good_ipv4 |= 1;
 	else if (i == AF_INET6)
@@ -291,14 +321,6 @@ vbp_poke(struct vbp_target *vt)
 	else
 		WRONG("Wrong probe protocol family");
 
-	t_now = VTIM_real();
-	tmo = (int)round((t_end - t_now) * 1e3);
-	if (tmo <= 0) {
-		/* Spent too long time getting it */
-		VTCP_close(&s);
-		return;
-	}
-
 	Lck_Lock(&vbp_mtx);
 	if (vt->backend != NULL)
 		proxy_header = vt->backend->proxy_header;
@@ -307,57 +329,58 @@ vbp_poke(struct vbp_target *vt)
 	Lck_Unlock(&vbp_mtx);
 
 	if (proxy_header < 0)
-		return;
+		return (-1);
 
 	/* Send the PROXY header */
 	assert(proxy_header <= 2);
 	if (proxy_header == 1) {
-		if (vbp_write_proxy_v1(vt, &s) != 0)
-			return;
+		if (vbp_write_proxy_v1(vt, &vt->fd) != 0)
+			return (-1);
 	} else if (proxy_header == 2 &&
-	    vbp_write(vt, &s, vbp_proxy_local, sizeof vbp_proxy_local) != 0)
-		return;
+	    vbp_write(vt, &vt->fd, vbp_proxy_local,
+	    sizeof vbp_proxy_local) != 0)
+		return (-1);
 
 	/* Send the request */
-	if (vbp_write(vt, &s, vt->req, vt->req_len) != 0)
-		return;
+	if (vbp_write(vt, &vt->fd, vt->req, vt->req_len) != 0)
+		return (-1);
 	vt->good_xmit |= 1;
+	vt->sent = 1;
+	return (0);
+}
 
-	pfd->fd = s;
-	rlen = 0;
-	do {
-		pfd->events = POLLIN;
-		pfd->revents = 0;
-		tmo = (int)round((t_end - t_now) * 1e3);
-		if (tmo > 0)
-			i = poll(pfd, 1, tmo);
-		if (i == 0 || tmo <= 0) {
-			if (i == 0)
-				vt->err_recv |= 1;
-			VTCP_close(&s);
-			return;
-		}
-		if (rlen < sizeof vt->resp_buf)
-			i = read(s, vt->resp_buf + rlen,
-			    sizeof vt->resp_buf - rlen);
-		else
-			i = read(s, buf, sizeof buf);
-		rlen += i;
-	} while (i > 0);
+/*--------------------------------------------------------------------
+ * Read what the backend has for us, zero means come back for more.
+ */
 
-	VTCP_close(&s);
+static int
+vbp_recv(struct vbp_target *vt)
+{
+	static char buf[8192];
+	unsigned resp;
+	char *p;
+	int i;
+
+	if (vt->rlen < sizeof vt->resp_buf)
+		i = read(vt->fd, vt->resp_buf + vt->rlen,
+		    sizeof vt->resp_buf - vt->rlen);
+	else
+		i = read(vt->fd, buf, sizeof buf);
+	if (i > 0) {
+		vt->rlen += i;
+		return (0);
+	}
 
 	if (i < 0) {
 		vt->err_recv |= 1;
-		return;
+		return (-1);
 	}
 
-	if (rlen == 0)
-		return;
+	if (vt->rlen == 0)
+		return (-1);
 
 	/* So we have a good receive ... */
-	t_now = VTIM_real();
-	vt->last = t_now - t_start;
+	vt->last = VTIM_real() - vt->t_start;
 	vt->good_recv |= 1;
 
 	/* Now find out if we like the response */
@@ -373,25 +396,34 @@ vbp_poke(struct vbp_target *vt)
 
 	if (i == 1 && resp == vt->exp_status)
 		vt->happy |= 1;
+	return (-1);
 }
 
 /*--------------------------------------------------------------------
+ * Next time to probe, with the interval spread by probe_jitter
  */
 
-static void __match_proto__(task_func_t)
-vbp_task(struct worker *wrk, void *priv)
+static double
+vbp_due(const struct vbp_target *vt, double now)
 {
-	struct vbp_target *vt;
+	double j;
 
-	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
-	CAST_OBJ_NOTNULL(vt, priv, VBP_TARGET_MAGIC);
+	j = cache_param->probe_jitter;
+	if (j > 0.)
+		j *= 2. * VRND_RandomTestableDouble() - 1.;
+	return (now + vt->interval * (1. + j));
+}
 
-	AN(vt->running);
-	AN(vt->req);
-	assert(vt->req_len > 0);
+/*--------------------------------------------------------------------
+ * Record the outcome of a probe and reschedule it.
+ */
 
-	vbp_start_poke(vt);
-	vbp_poke(vt);
+static void
+vbp_done(struct vbp_target *vt)
+{
+
+	if (vt->fd >= 0)
+		VTCP_close(&vt->fd);
 	vbp_has_poked(vt);
 	vbp_update_backend(vt);
 
@@ -402,7 +434,7 @@ vbp_task(struct worker *wrk, void *priv)
 	} else {
 		vt->running = 0;
 		if (vt->heap_idx != BINHEAP_NOIDX) {
-			vt->due = VTIM_real() + vt->interval;
+			vt->due = vbp_due(vt, VTIM_real());
 			binheap_delete(vbp_heap, vt->heap_idx);
 			binheap_insert(vbp_heap, vt);
 		}
@@ -410,46 +442,129 @@ vbp_task(struct worker *wrk, void *priv)
 	Lck_Unlock(&vbp_mtx);
 }
 
+/*--------------------------------------------------------------------
+ * Start a probe: the connect is not waited for here, the poller
+ * picks it up when the socket turns writable.
+ */
+
+static int
+vbp_start(struct vbp_target *vt, double now)
+{
+
+	AN(vt->running);
+	AN(vt->req);
+	assert(vt->req_len > 0);
+
+	vbp_start_poke(vt);
+	vt->t_start = now;
+	vt->t_end = now + vt->timeout;
+	vt->sent = 0;
+	vt->rlen = 0;
+	vt->fd = VBT_Open(vt->tcp_pool, -1, &vt->sa);
+	if (vt->fd < 0) {
+		vbp_done(vt);
+		return (-1);
+	}
+	return (0);
+}
+
 /*--------------------------------------------------------------------
  */
 
 static void * __match_proto__()
 vbp_thread(struct worker *wrk, void *priv)
 {
+	struct vbp_head start = VTAILQ_HEAD_INITIALIZER(start);
+	struct vbp_head run = VTAILQ_HEAD_INITIALIZER(run);
+	struct pollfd *pfd = NULL;
+	unsigned npfd = 0, nrun = 0, u;
+	struct vbp_target *vt, *vt2;
 	double now, nxt;
-	struct vbp_target *vt;
+	char buf[64];
+	int i, tmo;
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	AZ(priv);
-	Lck_Lock(&vbp_mtx);
 	while (1) {
 		now = VTIM_real();
-		vt = binheap_root(vbp_heap);
-		if (vt == NULL) {
-			nxt = 8.192 + now;
-			(void)Lck_CondWait(&vbp_cond, &vbp_mtx, nxt);
-		} else if (vt->due > now) {
-			nxt = vt->due;
-			vt = NULL;
-			(void)Lck_CondWait(&vbp_cond, &vbp_mtx, nxt);
-		} else {
+		Lck_Lock(&vbp_mtx);
+		while (1) {
+			vt = binheap_root(vbp_heap);
+			if (vt == NULL || vt->due > now)
+				break;
 			binheap_delete(vbp_heap, vt->heap_idx);
-			vt->due = now + vt->interval;
+			vt->due = vbp_due(vt, now);
 			if (!vt->running) {
 				vt->running = 1;
-				vt->task.func = vbp_task;
-				vt->task.priv = vt;
-				if (Pool_Task_Any(&vt->task, TASK_QUEUE_REQ))
-					vt->running = 0;
+				VTAILQ_INSERT_TAIL(&start, vt, list);
 			}
 			binheap_insert(vbp_heap, vt);
 		}
+		nxt = vt == NULL ? now + 8.192 : vt->due;
+		Lck_Unlock(&vbp_mtx);
+
+		VTAILQ_FOREACH_SAFE(vt, &start, list, vt2) {
+			VTAILQ_REMOVE(&start, vt, list);
+			if (vbp_start(vt, now))
+				continue;
+			VTAILQ_INSERT_TAIL(&run, vt, list);
+			nrun++;
+		}
+
+		if (nrun + 1 > npfd) {
+			npfd = 2 * (nrun + 1);
+			pfd = realloc(pfd, npfd * sizeof *pfd);
+			AN(pfd);
+		}
+		pfd[0].fd = vbp_pipe[0];
+		pfd[0].events = POLLIN;
+		u = 1;
+		VTAILQ_FOREACH(vt, &run, list) {
+			pfd[u].fd = vt->fd;
+			pfd[u].events = vt->sent ? POLLIN : POLLOUT;
+			u++;
+			if (vt->t_end < nxt)
+				nxt = vt->t_end;
+		}
+		assert(u == nrun + 1);
+
+		tmo = (int)ceil((nxt - now) * 1e3);
+		if (tmo < 0)
+			tmo = 0;
+		i = poll(pfd, nrun + 1, tmo);
+		assert(i >= 0 || errno == EINTR);
+		if (i <= 0)
+			memset(pfd, 0, (nrun + 1) * sizeof *pfd);
+
+		if (pfd[0].revents)
+			(void)read(vbp_pipe[0], buf, sizeof buf);
+
+		now = VTIM_real();
+		u = 1;
+		VTAILQ_FOREACH_SAFE(vt, &run, list, vt2) {
+			if (pfd[u].revents && !vt->sent)
+				i = vbp_send(vt, now);
+			else if (pfd[u].revents)
+				i = vbp_recv(vt);
+			else if (now >= vt->t_end && !vt->sent)
+				i = vbp_connect_next(vt, now);
+			else if (now >= vt->t_end) {
+				vt->err_recv |= 1;
+				i = -1;
+			} else
+				i = 0;
+			u++;
+			if (i == 0)
+				continue;
+			VTAILQ_REMOVE(&run, vt, list);
+			nrun--;
+			vbp_done(vt);
+		}
 	}
-	NEEDLESS(Lck_Unlock(&vbp_mtx));
+	NEEDLESS(free(pfd));
 	NEEDLESS(return NULL);
 }
 
-
 /*--------------------------------------------------------------------
  * Cli functions
  */
@@ -588,7 +703,7 @@ VBP_Control(const struct backend *be, int enable)
 		assert(vt->heap_idx == BINHEAP_NOIDX);
 		vt->due = VTIM_real();
 		binheap_insert(vbp_heap, vt);
-		AZ(pthread_cond_signal(&vbp_cond));
+		(void)write(vbp_pipe[1], "", 1);
 	} else {
 		assert(vt->heap_idx != BINHEAP_NOIDX);
 		binheap_delete(vbp_heap, vt->heap_idx);
@@ -686,6 +801,8 @@ VBP_Init(void)
 	Lck_New(&vbp_mtx, lck_backend);
 	vbp_heap = binheap_new(NULL, vbp_cmp, vbp_update);
 	AN(vbp_heap);
-	AZ(pthread_cond_init(&vbp_cond, NULL));
+	AZ(pipe(vbp_pipe));
+	(void)VTCP_nonblocking(vbp_pipe[0]);
+	(void)VTCP_nonblocking(vbp_pipe[1]);
 	WRK_BgThread(&thr, "backend-poller", vbp_thread, NULL);
 }
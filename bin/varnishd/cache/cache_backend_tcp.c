@@ -30,6 +30,12 @@
  * These are really a lot more general than just backends, but backends
  * are all we use them for, so they live here for now.
  *
+ * The idle connections of a pool are split in slots, one per thread
+ * pool, each with its own lock.  Workers recycle connections into and
+ * take them from the slot of their own thread pool, and only go looking
+ * in the other slots when theirs is empty, so busy backends do not
+ * make all the fetches serialize on one lock.
+ *
  */
 
 #include "config.h"
@@ -47,6 +53,18 @@
 #include "cache_backend.h"
 #include "cache_pool.h"
 
+struct vbt_slot {
+	struct lock		mtx;
+
+	VTAILQ_HEAD(, vbc)	connlist;
+	int			n_conn;
+
+	VTAILQ_HEAD(, vbc)	killlist;
+	int			n_kill;
+
+	int			n_used;
+};
+
 struct tcp_pool {
 	unsigned		magic;
 #define TCP_POOL_MAGIC		0x28b0e42a
@@ -57,19 +75,43 @@ struct tcp_pool {
 
 	VTAILQ_ENTRY(tcp_pool)	list;
 	int			refcnt;
+
+	unsigned		nslot;
+	struct vbt_slot		*slot;
+
+	/* Pre-opening of idle connections, see VBT_Warm() */
 	struct lock		mtx;
+	struct pool_task	warm_task;
+	int			warming;
+	unsigned		warm_target;
+	double			warm_tmo;
+};
 
-	VTAILQ_HEAD(, vbc)	connlist;
-	int			n_conn;
+static struct lock		pools_mtx;
+static VTAILQ_HEAD(, tcp_pool)	pools = VTAILQ_HEAD_INITIALIZER(pools);
 
-	VTAILQ_HEAD(, vbc)	killlist;
-	int			n_kill;
+/*--------------------------------------------------------------------
+ * Slot helpers
+ */
 
-	int			n_used;
+static struct vbt_slot *
+vbt_slot(const struct tcp_pool *tp, const struct worker *wrk)
+{
 
-};
+	CHECK_OBJ_NOTNULL(wrk->pool, POOL_MAGIC);
+	return (&tp->slot[wrk->pool->nr % tp->nslot]);
+}
 
-static VTAILQ_HEAD(, tcp_pool)	pools = VTAILQ_HEAD_INITIALIZER(pools);
+/* Unlocked, so only good for heuristics */
+static unsigned
+vbt_n_conn(const struct tcp_pool *tp)
+{
+	unsigned u, n = 0;
+
+	for (u = 0; u < tp->nslot; u++)
+		n += tp->slot[u].n_conn;
+	return (n);
+}
 
 /*--------------------------------------------------------------------
  * Waiter-handler
@@ -79,40 +121,41 @@ static void  __match_proto__(waiter_handle_f)
 tcp_handle(struct waited *w, enum wait_event ev, double now)
 {
 	struct vbc *vbc;
-	struct tcp_pool *tp;
+	struct vbt_slot *sp;
 
 	CAST_OBJ_NOTNULL(vbc, w->priv1, VBC_MAGIC);
 	(void)ev;
 	(void)now;
 	CHECK_OBJ_NOTNULL(vbc->tcp_pool, TCP_POOL_MAGIC);
-	tp = vbc->tcp_pool;
+	sp = vbc->slot;
+	AN(sp);
 
-	Lck_Lock(&tp->mtx);
+	Lck_Lock(&sp->mtx);
 
 	switch (vbc->state) {
 	case VBC_STATE_STOLEN:
 		vbc->state = VBC_STATE_USED;
-		VTAILQ_REMOVE(&tp->connlist, vbc, list);
+		VTAILQ_REMOVE(&sp->connlist, vbc, list);
 		AN(vbc->cond);
 		AZ(pthread_cond_signal(vbc->cond));
 		break;
 	case VBC_STATE_AVAIL:
 		VTCP_close(&vbc->fd);
-		VTAILQ_REMOVE(&tp->connlist, vbc, list);
-		tp->n_conn--;
+		VTAILQ_REMOVE(&sp->connlist, vbc, list);
+		sp->n_conn--;
 		FREE_OBJ(vbc);
 		break;
 	case VBC_STATE_CLEANUP:
 		VTCP_close(&vbc->fd);
-		tp->n_kill--;
-		VTAILQ_REMOVE(&tp->killlist, vbc, list);
+		sp->n_kill--;
+		VTAILQ_REMOVE(&sp->killlist, vbc, list);
 		memset(vbc, 0x11, sizeof *vbc);
 		free(vbc);
 		break;
 	default:
 		WRONG("Wrong vbc state");
 	}
-	Lck_Unlock(&tp->mtx);
+	Lck_Unlock(&sp->mtx);
 }
 
 /*--------------------------------------------------------------------
@@ -124,7 +167,10 @@ struct tcp_pool *
 VBT_Ref(const struct suckaddr *ip4, const struct suckaddr *ip6)
 {
 	struct tcp_pool *tp;
+	struct vbt_slot *sp;
+	unsigned u;
 
+	Lck_Lock(&pools_mtx);
 	VTAILQ_FOREACH(tp, &pools, list) {
 		assert(tp->refcnt > 0);
 		if (ip4 == NULL) {
@@ -146,6 +192,7 @@ VBT_Ref(const struct suckaddr *ip4, const struct suckaddr *ip6)
 				continue;
 		}
 		tp->refcnt++;
+		Lck_Unlock(&pools_mtx);
 		return (tp);
 	}
 
@@ -157,50 +204,78 @@ VBT_Ref(const struct suckaddr *ip4, const struct suckaddr *ip6)
 		tp->ip6 = VSA_Clone(ip6);
 	tp->refcnt = 1;
 	Lck_New(&tp->mtx, lck_backend_tcp);
-	VTAILQ_INIT(&tp->connlist);
-	VTAILQ_INIT(&tp->killlist);
+
+	/* Thread pools added later share slots with the first ones */
+	tp->nslot = cache_param->wthread_pools;
+	if (tp->nslot == 0)
+		tp->nslot = 1;
+	tp->slot = calloc(tp->nslot, sizeof *tp->slot);
+	AN(tp->slot);
+	for (u = 0; u < tp->nslot; u++) {
+		sp = &tp->slot[u];
+		Lck_New(&sp->mtx, lck_backend_tcp);
+		VTAILQ_INIT(&sp->connlist);
+		VTAILQ_INIT(&sp->killlist);
+	}
 	VTAILQ_INSERT_HEAD(&pools, tp, list);
+	Lck_Unlock(&pools_mtx);
 	return (tp);
 }
 
 /*--------------------------------------------------------------------
  * Release TCP pool, destroy if last reference.
+ *
+ * A queued warm task holds a reference too, so the last one may be
+ * let go of from a worker thread.
  */
 
 void
 VBT_Rel(struct tcp_pool **tpp)
 {
 	struct tcp_pool *tp;
+	struct vbt_slot *sp;
 	struct vbc *vbc, *vbc2;
+	unsigned u;
+	int r;
 
 	TAKE_OBJ_NOTNULL(tp, tpp, TCP_POOL_MAGIC);
+	Lck_Lock(&pools_mtx);
 	assert(tp->refcnt > 0);
-	if (--tp->refcnt > 0)
+	r = --tp->refcnt;
+	if (r == 0)
+		VTAILQ_REMOVE(&pools, tp, list);
+	Lck_Unlock(&pools_mtx);
+	if (r > 0)
 		return;
-	AZ(tp->n_used);
-	VTAILQ_REMOVE(&pools, tp, list);
+	AZ(tp->warming);
+	Lck_Delete(&tp->mtx);
 	free(tp->name);
 	free(tp->ip4);
 	free(tp->ip6);
-	Lck_Lock(&tp->mtx);
-	VTAILQ_FOREACH_SAFE(vbc, &tp->connlist, list, vbc2) {
-		VTAILQ_REMOVE(&tp->connlist, vbc, list);
-		tp->n_conn--;
-		assert(vbc->state == VBC_STATE_AVAIL);
-		vbc->state = VBC_STATE_CLEANUP;
-		(void)shutdown(vbc->fd, SHUT_WR);
-		VTAILQ_INSERT_TAIL(&tp->killlist, vbc, list);
-		tp->n_kill++;
-	}
-	while (tp->n_kill) {
-		Lck_Unlock(&tp->mtx);
-		(void)usleep(20000);
-		Lck_Lock(&tp->mtx);
+	for (u = 0; u < tp->nslot; u++) {
+		sp = &tp->slot[u];
+		Lck_Lock(&sp->mtx);
+		AZ(sp->n_used);
+		VTAILQ_FOREACH_SAFE(vbc, &sp->connlist, list, vbc2) {
+			VTAILQ_REMOVE(&sp->connlist, vbc, list);
+			sp->n_conn--;
+			assert(vbc->state == VBC_STATE_AVAIL);
+			vbc->state = VBC_STATE_CLEANUP;
+			(void)shutdown(vbc->fd, SHUT_WR);
+			VTAILQ_INSERT_TAIL(&sp->killlist, vbc, list);
+			sp->n_kill++;
+		}
+		while (sp->n_kill) {
+			Lck_Unlock(&sp->mtx);
+			(void)usleep(20000);
+			Lck_Lock(&sp->mtx);
+		}
+		Lck_Unlock(&sp->mtx);
+		Lck_Delete(&sp->mtx);
+		AZ(sp->n_conn);
+		AZ(sp->n_kill);
 	}
-	Lck_Unlock(&tp->mtx);
-	Lck_Delete(&tp->mtx);
-	AZ(tp->n_conn);
-	AZ(tp->n_kill);
+	free(tp->slot);
 
 	FREE_OBJ(tp);
 }
@@ -235,13 +310,46 @@ VBT_Open(const struct tcp_pool *tp, double tmo, const struct suckaddr **sa)
 }
 
 /*--------------------------------------------------------------------
- * Recycle a connection.
+ * With a non-blocking VBT_Open() the connect to the preferred address
+ * can fail or time out after the fact.  Try the other address family,
+ * if there is one we have not been to yet.
+ */
+
+int
+VBT_OpenNext(const struct tcp_pool *tp, double tmo,
+    const struct suckaddr **sa)
+{
+	const struct suckaddr *nsa;
+
+	CHECK_OBJ_NOTNULL(tp, TCP_POOL_MAGIC);
+	AN(sa);
+
+	if (cache_param->prefer_ipv6 && *sa == tp->ip6)
+		nsa = tp->ip4;
+	else if (!cache_param->prefer_ipv6 && *sa == tp->ip4)
+		nsa = tp->ip6;
+	else
+		return (-1);
+	if (nsa == NULL)
+		return (-1);
+	*sa = nsa;
+	return (VTCP_connect(nsa, (int)floor(tmo * 1000.0)));
+}
+
+/*--------------------------------------------------------------------
+ * Recycle a connection.  With a max_idle, connections which would
+ * make the pool grow beyond it are closed instead.
+ *
+ * The connection goes into the slot of the recycling worker, which
+ * need not be the one it was counted in while in use.
  */
 
 void
-VBT_Recycle(const struct worker *wrk, struct tcp_pool *tp, struct vbc **vbcp)
+VBT_Recycle(const struct worker *wrk, struct tcp_pool *tp, struct vbc **vbcp,
+    unsigned max_idle)
 {
 	struct vbc *vbc;
+	struct vbt_slot *sp;
 	int i = 0;
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
@@ -253,8 +361,22 @@ VBT_Recycle(const struct worker *wrk, struct tcp_pool *tp, struct vbc **vbcp)
 	assert(vbc->state == VBC_STATE_USED);
 	assert(vbc->fd > 0);
 
-	Lck_Lock(&tp->mtx);
-	tp->n_used--;
+	sp = vbt_slot(tp, wrk);
+	Lck_Lock(&vbc->slot->mtx);
+	vbc->slot->n_used--;
+	if (vbc->slot != sp) {
+		Lck_Unlock(&vbc->slot->mtx);
+		Lck_Lock(&sp->mtx);
+		vbc->slot = sp;
+	}
+
+	if (max_idle > 0 && vbt_n_conn(tp) >= max_idle) {
+		Lck_Unlock(&sp->mtx);
+		VTCP_close(&vbc->fd);
+		memset(vbc, 0x33, sizeof *vbc);
+		free(vbc);
+		return;
+	}
 
 	vbc->waited->priv1 = vbc;
 	vbc->waited->fd = vbc->fd;
@@ -269,13 +391,13 @@ VBT_Recycle(const struct worker *wrk, struct tcp_pool *tp, struct vbc **vbcp)
 		// XXX: stats
 		vbc = NULL;
 	} else {
-		VTAILQ_INSERT_HEAD(&tp->connlist, vbc, list);
+		VTAILQ_INSERT_HEAD(&sp->connlist, vbc, list);
 		i++;
 	}
 
 	if (vbc != NULL)
-		tp->n_conn++;
-	Lck_Unlock(&tp->mtx);
+		sp->n_conn++;
+	Lck_Unlock(&sp->mtx);
 
 	if (i && DO_DEBUG(DBG_VTC_MODE)) {
 		/*
@@ -295,6 +417,111 @@ VBT_Recycle(const struct worker *wrk, struct tcp_pool *tp, struct vbc **vbcp)
 	}
 }
 
+/*--------------------------------------------------------------------
+ * Keep a number of idle connections open ahead of demand, so that a
+ * fetch after a quiet period, or after a VCL reload, need not wait for
+ * a TCP handshake.  The connections are opened from a worker thread
+ * and put in the pool exactly like recycled ones, where the waiter
+ * takes care of them if the backend closes them.
+ */
+
+static void __match_proto__(task_func_t)
+vbt_warm_task(struct worker *wrk, void *priv)
+{
+	struct tcp_pool *tp;
+	struct vbt_slot *sp;
+	struct vbc *vbc;
+	const struct suckaddr *sa;
+	unsigned target, nwarm = 0;
+	double tmo;
+	int fd, n;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CAST_OBJ_NOTNULL(tp, priv, TCP_POOL_MAGIC);
+	sp = vbt_slot(tp, wrk);
+
+	Lck_Lock(&tp->mtx);
+	AN(tp->warming);
+	target = tp->warm_target;
+	tmo = tp->warm_tmo;
+	Lck_Unlock(&tp->mtx);
+
+	/* Give up if connections keep disappearing under us */
+	for (n = (int)target - (int)vbt_n_conn(tp); n > 0; n--) {
+		if (vbt_n_conn(tp) >= target)
+			break;
+		Lck_Lock(&sp->mtx);
+		sp->n_used++;
+		Lck_Unlock(&sp->mtx);
+
+		fd = VBT_Open(tp, tmo, &sa);
+		if (fd < 0) {
+			Lck_Lock(&sp->mtx);
+			sp->n_used--;
+			Lck_Unlock(&sp->mtx);
+			break;
+		}
+		ALLOC_OBJ(vbc, VBC_MAGIC);
+		AN(vbc);
+		INIT_OBJ(vbc->waited, WAITED_MAGIC);
+		vbc->state = VBC_STATE_USED;
+		vbc->tcp_pool = tp;
+		vbc->slot = sp;
+		vbc->fd = fd;
+		vbc->addr = sa;
+		nwarm++;
+		VBT_Recycle(wrk, tp, &vbc, 0);
+	}
+
+	Lck_Lock(&tp->mtx);
+	VSC_C_main->backend_warm += nwarm;
+	tp->warming = 0;
+	Lck_Unlock(&tp->mtx);
+	VBT_Rel(&tp);
+}
+
+void
+VBT_Warm(struct tcp_pool *tp, unsigned min_idle, double tmo)
+{
+	struct tcp_pool *tp2;
+
+	CHECK_OBJ_NOTNULL(tp, TCP_POOL_MAGIC);
+
+	Lck_Lock(&tp->mtx);
+	if (tp->warming) {
+		/* Pools are shared, warm for the most demanding backend */
+		if (min_idle > tp->warm_target)
+			tp->warm_target = min_idle;
+		Lck_Unlock(&tp->mtx);
+		return;
+	}
+	if (vbt_n_conn(tp) >= min_idle) {
+		Lck_Unlock(&tp->mtx);
+		return;
+	}
+	tp->warming = 1;
+	tp->warm_target = min_idle;
+	tp->warm_tmo = tmo;
+	Lck_Unlock(&tp->mtx);
+
+	/* The task holds a reference until it is done */
+	Lck_Lock(&pools_mtx);
+	assert(tp->refcnt > 0);
+	tp->refcnt++;
+	Lck_Unlock(&pools_mtx);
+
+	tp->warm_task.func = vbt_warm_task;
+	tp->warm_task.priv = tp;
+	if (Pool_Task_Any(&tp->warm_task, TASK_QUEUE_REQ)) {
+		/* No room for it now, try again at the next poll */
+		Lck_Lock(&tp->mtx);
+		tp->warming = 0;
+		Lck_Unlock(&tp->mtx);
+		tp2 = tp;
+		VBT_Rel(&tp2);
+	}
+}
+
 /*--------------------------------------------------------------------
  * Close a connection.
  */
@@ -303,6 +530,7 @@ void
 VBT_Close(struct tcp_pool *tp, struct vbc **vbcp)
 {
 	struct vbc *vbc;
+	struct vbt_slot *sp;
 
 	CHECK_OBJ_NOTNULL(tp, TCP_POOL_MAGIC);
 	vbc = *vbcp;
@@ -312,24 +540,55 @@ VBT_Close(struct tcp_pool *tp, struct vbc **vbcp)
 	assert(vbc->state == VBC_STATE_USED);
 	assert(vbc->fd > 0);
 
-	Lck_Lock(&tp->mtx);
-	tp->n_used--;
+	sp = vbc->slot;
+	AN(sp);
+	Lck_Lock(&sp->mtx);
+	sp->n_used--;
 	if (vbc->state == VBC_STATE_STOLEN) {
 		(void)shutdown(vbc->fd, SHUT_WR);
 		vbc->state = VBC_STATE_CLEANUP;
-		VTAILQ_INSERT_HEAD(&tp->killlist, vbc, list);
-		tp->n_kill++;
+		VTAILQ_INSERT_HEAD(&sp->killlist, vbc, list);
+		sp->n_kill++;
 	} else {
 		assert(vbc->state == VBC_STATE_USED);
 		VTCP_close(&vbc->fd);
 		memset(vbc, 0x44, sizeof *vbc);
 		free(vbc);
 	}
-	Lck_Unlock(&tp->mtx);
+	Lck_Unlock(&sp->mtx);
+}
+
+/*--------------------------------------------------------------------
+ * Take the most recently recycled connection of a slot, if any.
+ * The vbc stays in the slot until the waiter lets go of it.
+ */
+
+static struct vbc *
+vbt_take(struct vbt_slot *sp, struct worker *wrk)
+{
+	struct vbc *vbc;
+
+	Lck_AssertHeld(&sp->mtx);
+	vbc = VTAILQ_FIRST(&sp->connlist);
+	CHECK_OBJ_ORNULL(vbc, VBC_MAGIC);
+	if (vbc == NULL || vbc->state == VBC_STATE_STOLEN)
+		return (NULL);
+	assert(vbc->slot == sp);
+	assert(vbc->state == VBC_STATE_AVAIL);
+	VTAILQ_REMOVE(&sp->connlist, vbc, list);
+	VTAILQ_INSERT_TAIL(&sp->connlist, vbc, list);
+	sp->n_conn--;
+	sp->n_used++;
+	VSC_C_main->backend_reuse++;
+	vbc->recycled = 1;
+	vbc->state = VBC_STATE_STOLEN;
+	vbc->cond = &wrk->cond;
+	return (vbc);
 }
 
 /*--------------------------------------------------------------------
- * Get a connection
+ * Get a connection, from our own slot if possible, then from the
+ * other slots, and only then open a new one.
  */
 
 struct vbc *
@@ -337,43 +596,52 @@ VBT_Get(struct tcp_pool *tp, double tmo, const struct backend *be,
     struct worker *wrk)
 {
 	struct vbc *vbc;
+	struct vbt_slot *sp, *sp2;
+	unsigned u, n;
 
 	CHECK_OBJ_NOTNULL(tp, TCP_POOL_MAGIC);
 	CHECK_OBJ_NOTNULL(be, BACKEND_MAGIC);
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 
-	Lck_Lock(&tp->mtx);
-	vbc = VTAILQ_FIRST(&tp->connlist);
-	CHECK_OBJ_ORNULL(vbc, VBC_MAGIC);
-	if (vbc == NULL || vbc->state == VBC_STATE_STOLEN)
-		vbc = NULL;
-	else {
-		assert(vbc->tcp_pool == tp);
-		assert(vbc->state == VBC_STATE_AVAIL);
-		VTAILQ_REMOVE(&tp->connlist, vbc, list);
-		VTAILQ_INSERT_TAIL(&tp->connlist, vbc, list);
-		tp->n_conn--;
-		VSC_C_main->backend_reuse++;
-		vbc->state = VBC_STATE_STOLEN;
-		vbc->cond = &wrk->cond;
-	}
-	tp->n_used++;			// Opening mostly works
-	Lck_Unlock(&tp->mtx);
+	sp = vbt_slot(tp, wrk);
+	Lck_Lock(&sp->mtx);
+	vbc = vbt_take(sp, wrk);
+	if (vbc == NULL)
+		sp->n_used++;		// Opening mostly works
+	Lck_Unlock(&sp->mtx);
 
 	if (vbc != NULL)
 		return (vbc);
 
+	n = sp - tp->slot;
+	for (u = 1; u < tp->nslot; u++) {
+		sp2 = &tp->slot[(n + u) % tp->nslot];
+		if (sp2->n_conn == 0)
+			continue;
+		Lck_Lock(&sp2->mtx);
+		vbc = vbt_take(sp2, wrk);
+		Lck_Unlock(&sp2->mtx);
+		if (vbc != NULL) {
+			VSC_C_main->backend_steal++;
+			Lck_Lock(&sp->mtx);
+			sp->n_used--;		// Not ours after all
+			Lck_Unlock(&sp->mtx);
+			return (vbc);
+		}
+	}
+
 	ALLOC_OBJ(vbc, VBC_MAGIC);
 	AN(vbc);
 	INIT_OBJ(vbc->waited, WAITED_MAGIC);
 	vbc->state = VBC_STATE_USED;
 	vbc->tcp_pool = tp;
+	vbc->slot = sp;
 	vbc->fd = VBT_Open(tp, tmo, &vbc->addr);
 	if (vbc->fd < 0) {
 		FREE_OBJ(vbc);
-		Lck_Lock(&tp->mtx);
-		tp->n_used--;		// Nope, didn't work after all.
-		Lck_Unlock(&tp->mtx);
+		Lck_Lock(&sp->mtx);
+		sp->n_used--;		// Nope, didn't work after all.
+		Lck_Unlock(&sp->mtx);
 	} else
 		VSC_C_main->backend_conn++;
 
@@ -386,17 +654,28 @@ VBT_Get(struct tcp_pool *tp, double tmo, const struct backend *be,
 void
 VBT_Wait(struct worker *wrk, struct vbc *vbc)
 {
-	struct tcp_pool *tp;
+	struct vbt_slot *sp;
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(vbc, VBC_MAGIC);
-	tp = vbc->tcp_pool;
-	CHECK_OBJ_NOTNULL(tp, TCP_POOL_MAGIC);
+	CHECK_OBJ_NOTNULL(vbc->tcp_pool, TCP_POOL_MAGIC);
+	sp = vbc->slot;
+	AN(sp);
 	assert(vbc->cond == &wrk->cond);
-	Lck_Lock(&tp->mtx);
+	Lck_Lock(&sp->mtx);
 	while (vbc->state == VBC_STATE_STOLEN)
-		AZ(Lck_CondWait(&wrk->cond, &tp->mtx, 0));
+		AZ(Lck_CondWait(&wrk->cond, &sp->mtx, 0));
 	assert(vbc->state == VBC_STATE_USED);
 	vbc->cond = NULL;
-	Lck_Unlock(&tp->mtx);
+	Lck_Unlock(&sp->mtx);
+}
+
+/*--------------------------------------------------------------------
+ */
+
+void
+VBT_Init(void)
+{
+
+	Lck_New(&pools_mtx, lck_backend_tcp);
 }
@@ -515,6 +515,19 @@ ban_evaluate(struct worker *wrk, const uint8_t *bs, struct objcore *oc,
 	return (1);
 }
 
+/*--------------------------------------------------------------------
+ * Has the object been checked against all bans?  This is the unlocked
+ * check BAN_CheckObject() starts with, so the answer may be stale.
+ */
+
+int
+BAN_Current(const struct objcore *oc)
+{
+
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	return (oc->ban == ban_start);
+}
+
 /*--------------------------------------------------------------------
  * Check an object against all applicable bans
  *
@@ -0,0 +1,243 @@
+/*-
+ * Copyright (c) 2017 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Brotli variants of objects
+ *
+ * With beresp.do_brotli, a brotli compressed copy of the body is made
+ * while the object is fetched, and stored in the OA_BRBODY attribute.
+ * Clients which accept "br" are served that instead of the body, so
+ * the compression is paid for once per object, not once per request.
+ *
+ * We see the body as it goes into storage, if that is gzip'ed we
+ * gunzip it first.  If the brotli copy does not come out smaller
+ * than the stored body, we do not keep it.
+ *
+ * The brotli copy is collected in memory until the body is complete,
+ * so it is given up as soon as it grows past param.brotli_max_size.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "cache.h"
+#include "cache_filter.h"
+
+#include "vsb.h"
+
+#ifdef HAVE_BROTLI
+
+#include <brotli/encode.h>
+
+struct vbr_priv {
+	unsigned		magic;
+#define VBR_PRIV_MAGIC		0x5a9a2d3e
+	BrotliEncoderState	*enc;
+	struct vgz		*vgz;
+	int			vgz_end;
+	int			failed;
+	uint8_t			*buf;
+	ssize_t			buf_len;
+	ssize_t			stored;
+	struct vsb		*vsb;
+};
+
+/*--------------------------------------------------------------------*/
+
+static int
+vbr_compress(struct vbr_priv *vbr, const uint8_t *p, size_t len,
+    BrotliEncoderOperation op)
+{
+	size_t avail_out = 0, l;
+	const uint8_t *o;
+
+	do {
+		if (!BrotliEncoderCompressStream(vbr->enc, op, &len, &p,
+		    &avail_out, NULL, NULL))
+			return (-1);
+		while (BrotliEncoderHasMoreOutput(vbr->enc)) {
+			l = 0;
+			o = BrotliEncoderTakeOutput(vbr->enc, &l);
+			(void)VSB_bcat(vbr->vsb, o, l);
+		}
+		if (VSB_len(vbr->vsb) > cache_param->brotli_max_size)
+			return (-1);
+	} while (len > 0 || (op == BROTLI_OPERATION_FINISH &&
+	    !BrotliEncoderIsFinished(vbr->enc)));
+	return (VSB_error(vbr->vsb) ? -1 : 0);
+}
+
+static int
+vbr_feed(struct vbr_priv *vbr, const void *p, ssize_t len)
+{
+	enum vgzret_e vr;
+	const void *dp;
+	ssize_t dl;
+
+	if (vbr->vgz == NULL)
+		return (vbr_compress(vbr, p, len, BROTLI_OPERATION_PROCESS));
+
+	if (vbr->vgz_end)
+		return (-1);		/* Junk after the gzip stream */
+	VGZ_Ibuf(vbr->vgz, p, len);
+	do {
+		VGZ_Obuf(vbr->vgz, vbr->buf, vbr->buf_len);
+		vr = VGZ_Gunzip(vbr->vgz, &dp, &dl);
+		if (vr < VGZ_OK)
+			return (-1);
+		if (dl > 0 && vbr_compress(vbr, dp, dl,
+		    BROTLI_OPERATION_PROCESS))
+			return (-1);
+	} while (vr == VGZ_OK &&
+	    (!VGZ_IbufEmpty(vbr->vgz) || VGZ_ObufFull(vbr->vgz)));
+	if (vr == VGZ_END)
+		vbr->vgz_end = 1;
+	else if (!VGZ_IbufEmpty(vbr->vgz))
+		return (-1);
+	return (0);
+}
+
+static void
+vbr_release(struct vbr_priv *vbr)
+{
+
+	if (vbr->enc != NULL)
+		BrotliEncoderDestroyInstance(vbr->enc);
+	vbr->enc = NULL;
+	if (vbr->vgz != NULL)
+		(void)VGZ_Destroy(&vbr->vgz);
+	if (vbr->vsb != NULL)
+		VSB_delete(vbr->vsb);
+	vbr->vsb = NULL;
+	free(vbr->buf);
+	vbr->buf = NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+static enum vfp_status __match_proto__(vfp_init_f)
+vfp_brotli_init(struct vfp_ctx *vc, struct vfp_entry *vfe)
+{
+	struct vbr_priv *vbr;
+	ssize_t cl;
+
+	CHECK_OBJ_NOTNULL(vc, VFP_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(vfe, VFP_ENTRY_MAGIC);
+
+	if (http_HdrIs(vc->http, H_Content_Length, "0"))
+		return (VFP_NULL);
+	if (http_GetHdr(vc->http, H_Content_Encoding, NULL) &&
+	    !http_HdrIs(vc->http, H_Content_Encoding, "gzip"))
+		return (VFP_NULL);
+
+	ALLOC_OBJ(vbr, VBR_PRIV_MAGIC);
+	if (vbr == NULL)
+		return (VFP_ERROR);
+	vfe->priv1 = vbr;
+
+	vbr->enc = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+	vbr->vsb = VSB_new_auto();
+	if (vbr->enc == NULL || vbr->vsb == NULL)
+		return (VFP_ERROR);
+	AN(BrotliEncoderSetParameter(vbr->enc, BROTLI_PARAM_QUALITY,
+	    cache_param->brotli_level));
+	cl = http_GetContentLength(vc->http);
+
+	if (http_HdrIs(vc->http, H_Content_Encoding, "gzip")) {
+		vbr->vgz = VGZ_NewGunzip(vc->wrk->vsl, "U F B");
+		vbr->buf_len = cache_param->gzip_buffer;
+		vbr->buf = malloc(vbr->buf_len);
+		if (vbr->vgz == NULL || vbr->buf == NULL)
+			return (VFP_ERROR);
+	} else if (cl > 0 && cl <= UINT32_MAX)
+		(void)BrotliEncoderSetParameter(vbr->enc,
+		    BROTLI_PARAM_SIZE_HINT, (uint32_t)cl);
+
+	RFC2616_Vary_AE(vc->http);
+	return (VFP_OK);
+}
+
+static enum vfp_status __match_proto__(vfp_pull_f)
+vfp_brotli_pull(struct vfp_ctx *vc, struct vfp_entry *vfe, void *p,
+    ssize_t *lp)
+{
+	struct vbr_priv *vbr;
+	enum vfp_status vp;
+
+	CHECK_OBJ_NOTNULL(vc, VFP_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(vfe, VFP_ENTRY_MAGIC);
+	CAST_OBJ_NOTNULL(vbr, vfe->priv1, VBR_PRIV_MAGIC);
+	AN(p);
+	AN(lp);
+
+	vp = VFP_Suck(vc, p, lp);
+	if (vp == VFP_ERROR || vbr->failed)
+		return (vp);
+	vbr->stored += *lp;
+	if (*lp > 0 && vbr_feed(vbr, p, *lp)) {
+		VSLb(vc->wrk->vsl, SLT_Debug, "Brotli failed, skipped");
+		vbr->failed = 1;
+		vbr_release(vbr);
+		return (vp);
+	}
+	if (vp != VFP_END)
+		return (vp);
+
+	if (vbr_compress(vbr, NULL, 0, BROTLI_OPERATION_FINISH) ||
+	    VSB_finish(vbr->vsb) || (vbr->vgz != NULL && !vbr->vgz_end)) {
+		VSLb(vc->wrk->vsl, SLT_Debug, "Brotli failed, skipped");
+		return (vp);
+	}
+	if (VSB_len(vbr->vsb) < vbr->stored &&
+	    ObjSetAttr(vc->wrk, vc->oc, OA_BRBODY, VSB_len(vbr->vsb),
+	    VSB_data(vbr->vsb)) != NULL)
+		VSC_C_main->n_brotli++;
+	return (vp);
+}
+
+static void __match_proto__(vfp_fini_f)
+vfp_brotli_fini(struct vfp_ctx *vc, struct vfp_entry *vfe)
+{
+	struct vbr_priv *vbr;
+
+	CHECK_OBJ_NOTNULL(vc, VFP_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(vfe, VFP_ENTRY_MAGIC);
+
+	if (vfe->priv1 == NULL)
+		return;
+	CAST_OBJ_NOTNULL(vbr, vfe->priv1, VBR_PRIV_MAGIC);
+	vfe->priv1 = NULL;
+	vbr_release(vbr);
+	FREE_OBJ(vbr);
+}
+
+const struct vfp vfp_brotli = {
+	.name = "BROTLI",
+	.init = vfp_brotli_init,
+	.pull = vfp_brotli_pull,
+	.fini = vfp_brotli_fini,
+};
+
+#endif /* HAVE_BROTLI */
@@ -118,6 +118,7 @@ VDP_close(struct req *req)
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 	while (!VTAILQ_EMPTY(&req->vdp))
 		vdp_pop(req, VTAILQ_FIRST(&req->vdp)->func);
+	req->vdp_off = 0;
 }
 
 /*--------------------------------------------------------------------*/
@@ -132,11 +133,21 @@ vdp_objiterator(void *priv, int flush, const void *ptr, ssize_t len)
 int
 VDP_DeliverObj(struct req *req)
 {
+	const uint8_t *p;
+	ssize_t l;
 	int r;
 
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
-	r = ObjIterate(req->wrk, req->objcore, req, vdp_objiterator,
-	    req->objcore->flags & OC_F_PRIVATE ? 1 : 0);
+	if (req->res_mode & RES_BROTLI) {
+		p = ObjGetAttr(req->wrk, req->objcore, OA_BRBODY, &l);
+		AN(p);
+		assert(req->vdp_off <= l);
+		r = VDP_bytes(req, VDP_FLUSH, p + req->vdp_off,
+		    l - req->vdp_off);
+		return (r < 0 ? r : 0);
+	}
+	r = ObjIterateOffset(req->wrk, req->objcore, req->vdp_off, req,
+	    vdp_objiterator, req->objcore->flags & OC_F_PRIVATE ? 1 : 0);
 	if (r < 0)
 		return (r);
 	return (0);
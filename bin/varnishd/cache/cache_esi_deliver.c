@@ -37,6 +37,7 @@
 
 #include "cache_transport.h"
 #include "cache_filter.h"
+#include "hash/hash_slinger.h"
 
 #include "vtim.h"
 #include "cache_esi.h"
@@ -46,6 +47,9 @@
 static vtr_deliver_f ved_deliver;
 static vtr_reembark_f ved_reembark;
 
+struct ecx;
+static void ved_plan_include(struct req *, struct ecx *, struct objcore *);
+
 static const uint8_t gzip_hdr[] = {
 	0x1f, 0x8b, 0x08,
 	0x00, 0x00, 0x00, 0x00,
@@ -53,6 +57,28 @@ static const uint8_t gzip_hdr[] = {
 	0x02, 0x03
 };
 
+/*
+ * The fragments an ESI object included last time, one per include,
+ * along with the hash they were found under, see the esi_assembly
+ * feature.  The object holds a reference, and so does each delivery
+ * using it.
+ */
+
+struct ved_frag {
+	struct objcore		*oc;
+	uint8_t			digest[DIGEST_LEN];
+};
+
+struct ved_plan {
+	unsigned		magic;
+#define VED_PLAN_MAGIC		0x1d3c7b0e
+	int			refcnt;
+	unsigned		n;
+	struct ved_frag		frag[];
+};
+
+static struct lock ved_mtx;
+
 struct ecx {
 	unsigned	magic;
 #define ECX_MAGIC	0x0b0f9163
@@ -66,6 +92,11 @@ struct ecx {
 	struct req	*preq;
 	ssize_t		l_crc;
 	uint32_t	crc;
+
+	unsigned	incl;
+	struct ved_plan	*plan;		/* Delivering from */
+	struct ved_plan	*nplan;		/* Recording */
+	int		planned;
 };
 
 static const struct transport VED_transport = {
@@ -93,14 +124,13 @@ ved_reembark(struct worker *wrk, struct req *req)
 
 /*--------------------------------------------------------------------*/
 
-static void
-ved_include(struct req *preq, const char *src, const char *host,
+static struct req *
+ved_include_req(struct req *preq, const char *src, const char *host,
     struct ecx *ecx)
 {
 	struct worker *wrk;
 	struct sess *sp;
 	struct req *req;
-	enum req_fsm_nxt s;
 
 	CHECK_OBJ_NOTNULL(preq, REQ_MAGIC);
 	sp = preq->sp;
@@ -108,9 +138,6 @@ ved_include(struct req *preq, const char *src, const char *host,
 	CHECK_OBJ_NOTNULL(ecx, ECX_MAGIC);
 	wrk = preq->wrk;
 
-	if (preq->esi_level >= cache_param->max_esi_depth)
-		return;
-
 	req = Req_New(wrk, sp);
 	SES_Ref(sp);
 	req->req_body_status = REQ_BODY_NONE;
@@ -183,6 +210,58 @@ ved_include(struct req *preq, const char *src, const char *host,
 	VSLb_ts_req(req, "Start", W_TIM_real(wrk));
 
 	req->ws_req = WS_Snapshot(req->ws);
+	return (req);
+}
+
+static void
+ved_include_done(struct req *preq, struct req *req)
+{
+	struct worker *wrk;
+	struct sess *sp;
+
+	CHECK_OBJ_NOTNULL(preq, REQ_MAGIC);
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	sp = preq->sp;
+	wrk = preq->wrk;
+
+	VRTPRIV_dynamic_kill(sp->privs, (uintptr_t)req);
+
+	AZ(preq->vcl);
+	preq->vcl = req->vcl;
+	req->vcl = NULL;
+
+	req->wrk = NULL;
+	THR_SetRequest(preq);
+
+	Req_AcctLogCharge(wrk->stats, req);
+	Req_Release(req);
+	SES_Rel(sp);
+}
+
+static void
+ved_include(struct req *preq, const char *src, const char *host,
+    struct ecx *ecx)
+{
+	struct worker *wrk;
+	struct sess *sp;
+	struct req *req;
+	enum req_fsm_nxt s;
+
+	CHECK_OBJ_NOTNULL(preq, REQ_MAGIC);
+	sp = preq->sp;
+	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
+	CHECK_OBJ_NOTNULL(ecx, ECX_MAGIC);
+	wrk = preq->wrk;
+
+	if (preq->esi_level >= cache_param->max_esi_depth)
+		return;
+
+	req = ved_include_req(preq, src, host, ecx);
+	if (ecx->plan != NULL) {
+		assert(ecx->incl < ecx->plan->n);
+		req->esi_plan = 1;
+	}
+	ecx->planned = 0;
 
 	while (1) {
 		req->wrk = wrk;
@@ -202,18 +281,9 @@ ved_include(struct req *preq, const char *src, const char *host,
 		AZ(req->wrk);
 	}
 
-	VRTPRIV_dynamic_kill(sp->privs, (uintptr_t)req);
-
-	AZ(preq->vcl);
-	preq->vcl = req->vcl;
-	req->vcl = NULL;
-
-	req->wrk = NULL;
-	THR_SetRequest(preq);
-
-	Req_AcctLogCharge(wrk->stats, req);
-	Req_Release(req);
-	SES_Rel(sp);
+	if (ecx->planned)
+		ved_plan_include(req, ecx, ecx->plan->frag[ecx->incl].oc);
+	ved_include_done(preq, req);
 }
 
 /*--------------------------------------------------------------------*/
@@ -251,6 +321,291 @@ ved_decode_len(struct req *req, const uint8_t **pp)
 	return (l);
 }
 
+/*--------------------------------------------------------------------
+ * Find the next include in the ESI byte code, return what follows it
+ * or NULL if there are no more.
+ */
+
+static const uint8_t *
+ved_next_incl(struct req *req, const struct ecx *ecx, const uint8_t *p,
+    const char **src, const char **host)
+{
+	const uint8_t *q, *r;
+
+	while (p < ecx->e) {
+		switch (*p) {
+		case VEC_V1:
+		case VEC_V2:
+		case VEC_V8:
+			(void)ved_decode_len(req, &p);
+			if (ecx->isgzip) {
+				(void)ved_decode_len(req, &p);
+				p += 4;
+			}
+			break;
+		case VEC_S1:
+		case VEC_S2:
+		case VEC_S8:
+			(void)ved_decode_len(req, &p);
+			break;
+		case VEC_INCL:
+			p++;
+			q = (void*)strchr((const char*)p, '\0');
+			AN(q);
+			q++;
+			r = (void*)strchr((const char*)q, '\0');
+			AN(r);
+			*host = (const char*)p;
+			*src = (const char*)q;
+			return (r + 1);
+		default:
+			/* VDP_ESI will complain */
+			return (NULL);
+		}
+	}
+	return (NULL);
+}
+
+static unsigned
+ved_count_incl(struct req *req, const struct ecx *ecx)
+{
+	const uint8_t *p;
+	const char *src, *host;
+	unsigned n = 0;
+
+	p = ecx->p;
+	while ((p = ved_next_incl(req, ecx, p, &src, &host)) != NULL)
+		n++;
+	return (n);
+}
+
+/*--------------------------------------------------------------------
+ * Look the first max_esi_prefetch includes up before delivering any of
+ * them, so that those not in the cache are fetched at the same time
+ * rather than one after the other.  These requests stop once they
+ * have found the object or started the fetch, and when their turn
+ * comes, the includes find the object there or being fetched.
+ */
+
+static void
+ved_prefetch(struct req *preq, struct ecx *ecx)
+{
+	struct worker *wrk;
+	struct req *req;
+	const uint8_t *p;
+	const char *src, *host;
+	unsigned n = 0;
+
+	CHECK_OBJ_NOTNULL(preq, REQ_MAGIC);
+	CHECK_OBJ_NOTNULL(ecx, ECX_MAGIC);
+	wrk = preq->wrk;
+
+	if (preq->esi_level >= cache_param->max_esi_depth)
+		return;
+
+	p = ecx->p;
+	while (n < cache_param->max_esi_prefetch &&
+	    (p = ved_next_incl(preq, ecx, p, &src, &host)) != NULL) {
+		req = ved_include_req(preq, src, host, ecx);
+		req->esi_prefetch = 1;
+		req->wrk = wrk;
+		assert(CNT_Request(wrk, req) == REQ_FSM_DONE);
+		ved_include_done(preq, req);
+		wrk->stats->esi_prefetch++;
+		n++;
+	}
+}
+
+/*--------------------------------------------------------------------
+ * ESI assembly
+ *
+ * While an ESI object is delivered, we record the fragment each of its
+ * includes delivered, if it was a plain cache hit which the parent can
+ * deliver by itself: a complete object, which any request would find
+ * regardless of Vary, and without ESI processing or gunzip'ing.  If all
+ * includes qualify, the object keeps the list.
+ *
+ * Later deliveries use the list for as long as all the fragments on it
+ * are what a lookup would find.  Each include still runs vcl_recv{} and
+ * vcl_hash{}, as its hash may depend on the client, but if it comes out
+ * the same as last time, the fragment is delivered straight from
+ * storage without a lookup.  Otherwise the include carries on as usual.
+ * If a fragment is no longer current, the list goes, and the delivery
+ * records a new one.
+ */
+
+void
+VED_Init(void)
+{
+
+	Lck_New(&ved_mtx, lck_esi);
+}
+
+static struct ved_plan *
+ved_plan_new(unsigned n)
+{
+	struct ved_plan *plan;
+
+	plan = calloc(1, sizeof *plan + n * sizeof *plan->frag);
+	AN(plan);
+	plan->magic = VED_PLAN_MAGIC;
+	plan->refcnt = 1;
+	plan->n = n;
+	return (plan);
+}
+
+static void
+ved_plan_deref(struct worker *wrk, struct ved_plan **pplan)
+{
+	struct ved_plan *plan;
+	unsigned u;
+	int r;
+
+	AN(pplan);
+	plan = *pplan;
+	*pplan = NULL;
+	CHECK_OBJ_NOTNULL(plan, VED_PLAN_MAGIC);
+
+	Lck_Lock(&ved_mtx);
+	assert(plan->refcnt > 0);
+	r = --plan->refcnt;
+	Lck_Unlock(&ved_mtx);
+	if (r)
+		return;
+
+	for (u = 0; u < plan->n; u++)
+		if (plan->frag[u].oc != NULL)
+			(void)HSH_DerefObjCore(wrk, &plan->frag[u].oc, 0);
+	FREE_OBJ(plan);
+}
+
+/*
+ * Get the list of an object, if all its fragments are still current.
+ */
+
+static struct ved_plan *
+ved_plan_get(struct worker *wrk, struct objcore *oc, double now)
+{
+	struct ved_plan *plan;
+	unsigned u;
+
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+
+	Lck_Lock(&ved_mtx);
+	plan = oc->esi_plan;
+	if (plan != NULL)
+		plan->refcnt++;
+	Lck_Unlock(&ved_mtx);
+	if (plan == NULL)
+		return (NULL);
+
+	CHECK_OBJ(plan, VED_PLAN_MAGIC);
+	for (u = 0; u < plan->n; u++)
+		if (!HSH_Current(plan->frag[u].oc, now))
+			break;
+	if (u == plan->n)
+		return (plan);
+
+	Lck_Lock(&ved_mtx);
+	if (oc->esi_plan == plan) {
+		oc->esi_plan = NULL;
+		assert(plan->refcnt > 1);
+		plan->refcnt--;
+	}
+	Lck_Unlock(&ved_mtx);
+	ved_plan_deref(wrk, &plan);
+	return (NULL);
+}
+
+static void
+ved_plan_put(struct worker *wrk, struct objcore *oc, struct ved_plan **pplan)
+{
+	struct ved_plan *plan, *old;
+
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	AN(pplan);
+	plan = *pplan;
+	*pplan = NULL;
+	CHECK_OBJ_NOTNULL(plan, VED_PLAN_MAGIC);
+
+	Lck_Lock(&ved_mtx);
+	old = oc->esi_plan;
+	oc->esi_plan = plan;
+	Lck_Unlock(&ved_mtx);
+	if (old != NULL)
+		ved_plan_deref(wrk, &old);
+}
+
+/*
+ * Record the fragment an include delivers, or give up the recording.
+ */
+
+static void
+ved_plan_add(struct req *req, struct ecx *ecx, const struct boc *boc,
+    int wantbody)
+{
+	struct ved_plan *plan;
+	const uint8_t *vary = NULL;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	CHECK_OBJ_NOTNULL(ecx, ECX_MAGIC);
+	plan = ecx->nplan;
+	CHECK_OBJ_NOTNULL(plan, VED_PLAN_MAGIC);
+
+	if (ObjHasAttr(req->wrk, req->objcore, OA_VARY))
+		vary = ObjGetAttr(req->wrk, req->objcore, OA_VARY, NULL);
+
+	if (wantbody && boc == NULL && req->is_hit && req->restarts == 0 &&
+	    VTAILQ_EMPTY(&req->vdp) &&
+	    !(req->objcore->flags & OC_F_PRIVATE) &&
+	    (vary == NULL || VRY_MatchAll(vary)) &&
+	    ecx->incl < plan->n && plan->frag[ecx->incl].oc == NULL) {
+		HSH_Ref(req->objcore);
+		plan->frag[ecx->incl].oc = req->objcore;
+		memcpy(plan->frag[ecx->incl].digest, req->digest,
+		    sizeof req->digest);
+	} else
+		ved_plan_deref(req->wrk, &ecx->nplan);
+}
+
+/*
+ * An include delivering from the list is done once vcl_hash{} has shown
+ * it would look up the same fragment, and nothing asked to bypass what
+ * is in the cache, otherwise it carries on as usual.
+ */
+
+int
+VED_Planned(struct req *req)
+{
+	struct ecx *ecx;
+	const struct ved_frag *frag;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	AN(req->esi_plan);
+	assert(req->transport == &VED_transport);
+	CAST_OBJ_NOTNULL(ecx, req->transport_priv, ECX_MAGIC);
+	CHECK_OBJ_NOTNULL(ecx->plan, VED_PLAN_MAGIC);
+	assert(ecx->incl < ecx->plan->n);
+	frag = &ecx->plan->frag[ecx->incl];
+
+	req->esi_plan = 0;
+	if (req->restarts > 0 || req->hash_always_miss ||
+	    req->hash_ignore_busy ||
+	    memcmp(req->digest, frag->digest, sizeof req->digest))
+		return (0);
+	ecx->planned = 1;
+	return (1);
+}
+
+void
+VED_Free(struct worker *wrk, struct objcore *oc)
+{
+
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	AZ(oc->refcnt);
+	ved_plan_deref(wrk, &oc->esi_plan);
+}
+
 /*---------------------------------------------------------------------
  */
 
@@ -265,6 +620,7 @@ VDP_ESI(struct req *req, enum vdp_action act, void **priv,
 	const uint8_t *pp;
 	struct ecx *ecx, *pecx = NULL;
 	int retval = 0;
+	unsigned u;
 
 	if (act == VDP_INIT) {
 		AZ(*priv);
@@ -281,6 +637,10 @@ VDP_ESI(struct req *req, enum vdp_action act, void **priv,
 	}
 	CAST_OBJ_NOTNULL(ecx, *priv, ECX_MAGIC);
 	if (act == VDP_FINI) {
+		if (ecx->plan != NULL)
+			ved_plan_deref(req->wrk, &ecx->plan);
+		if (ecx->nplan != NULL)
+			ved_plan_deref(req->wrk, &ecx->nplan);
 		FREE_OBJ(ecx);
 		*priv = NULL;
 		return (0);
@@ -312,6 +672,18 @@ VDP_ESI(struct req *req, enum vdp_action act, void **priv,
 				ecx->isgzip = 1;
 				ecx->p++;
 			}
+			if (FEATURE(FEATURE_ESI_ASSEMBLY) &&
+			    !(req->objcore->flags & OC_F_PRIVATE) &&
+			    req->esi_level < cache_param->max_esi_depth) {
+				ecx->plan = ved_plan_get(req->wrk,
+				    req->objcore, req->t_req);
+				if (ecx->plan != NULL)
+					req->wrk->stats->esi_assembled++;
+				else if ((u = ved_count_incl(req, ecx)) > 0)
+					ecx->nplan = ved_plan_new(u);
+			}
+			if (ecx->plan == NULL)
+				ved_prefetch(req, ecx);
 			ecx->state = 1;
 			break;
 		case 1:
@@ -362,9 +734,10 @@ VDP_ESI(struct req *req, enum vdp_action act, void **priv,
 					break;
 				}
 				Debug("INCL [%s][%s] BEGIN\n", q, ecx->p);
-				ved_include(req,
-				    (const char*)q, (const char*)ecx->p, ecx);
+				ved_include(req, (const char*)q,
+				    (const char*)ecx->p, ecx);
 				Debug("INCL [%s][%s] END\n", q, ecx->p);
+				ecx->incl++;
 				ecx->p = r + 1;
 				break;
 			default:
@@ -375,6 +748,16 @@ VDP_ESI(struct req *req, enum vdp_action act, void **priv,
 			}
 			break;
 		case 2:
+			if (ecx->nplan != NULL) {
+				for (u = 0; u < ecx->nplan->n; u++)
+					if (ecx->nplan->frag[u].oc == NULL)
+						break;
+				if (u == ecx->nplan->n)
+					ved_plan_put(req->wrk, req->objcore,
+					    &ecx->nplan);
+				else
+					ved_plan_deref(req->wrk, &ecx->nplan);
+			}
 			if (ecx->isgzip && pecx == NULL) {
 				/*
 				 * We are bytealigned here, so simply emit
@@ -437,14 +820,15 @@ VDP_ESI(struct req *req, enum vdp_action act, void **priv,
 }
 
 /*
- * Account body bytes on req
+ * Account body bytes on req, if there is one
  * Push bytes to preq
  */
 static inline int
 ved_bytes(struct req *req, struct req *preq, enum vdp_action act,
     const void *ptr, ssize_t len)
 {
-	req->acct.resp_bodybytes += len;
+	if (req != NULL)
+		req->acct.resp_bodybytes += len;
 	return (VDP_bytes(preq, act, ptr, len));
 }
 
@@ -466,27 +850,18 @@ ved_bytes(struct req *req, struct req *preq, enum vdp_action act,
  * the stream with a bit more overhead.
  */
 
-static int __match_proto__(vdp_bytes)
-ved_pretend_gzip(struct req *req, enum vdp_action act, void **priv,
+static int
+ved_pretend_gzip_bytes(struct req *req, struct ecx *ecx, enum vdp_action act,
     const void *pv, ssize_t l)
 {
 	uint8_t buf1[5], buf2[5];
 	const uint8_t *p;
 	uint16_t lx;
-	struct ecx *ecx;
 	struct req *preq;
 
-	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
-	CAST_OBJ_NOTNULL(ecx, *priv, ECX_MAGIC);
+	CHECK_OBJ_NOTNULL(ecx, ECX_MAGIC);
 	preq = ecx->preq;
 
-	(void)priv;
-	if (act == VDP_INIT)
-		return (0);
-	if (act == VDP_FINI) {
-		*priv = NULL;
-		return (0);
-	}
 	if (l == 0)
 		return (ved_bytes(req, ecx->preq, act, pv, l));
 
@@ -523,6 +898,25 @@ ved_pretend_gzip(struct req *req, enum vdp_action act, void **priv,
 	return (ved_bytes(req, preq, VDP_FLUSH, NULL, 0));
 }
 
+static int __match_proto__(vdp_bytes)
+ved_pretend_gzip(struct req *req, enum vdp_action act, void **priv,
+    const void *pv, ssize_t l)
+{
+	struct ecx *ecx;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	CAST_OBJ_NOTNULL(ecx, *priv, ECX_MAGIC);
+
+	(void)priv;
+	if (act == VDP_INIT)
+		return (0);
+	if (act == VDP_FINI) {
+		*priv = NULL;
+		return (0);
+	}
+	return (ved_pretend_gzip_bytes(req, ecx, act, pv, l));
+}
+
 /*---------------------------------------------------------------------
  * Include an object in a gzip'ed ESI object delivery
  *
@@ -550,7 +944,7 @@ struct ved_foo {
 	ssize_t start, last, stop, lpad;
 	ssize_t ll;
 	uint64_t olen;
-	uint8_t *dbits;
+	uint8_t dbits[8];
 	uint8_t tailbuf[8];
 };
 
@@ -694,19 +1088,20 @@ ved_objiterate(void *priv, int flush, const void *ptr, ssize_t len)
 }
 
 static void
-ved_stripgzip(struct req *req, const struct boc *boc)
+ved_stripgzip(struct req *req, struct ecx *ecx, struct objcore *oc,
+    const struct boc *boc)
 {
 	ssize_t l;
 	const char *p;
 	uint32_t icrc;
 	uint32_t ilen;
-	uint8_t *dbits;
-	struct ecx *ecx;
+	struct worker *wrk;
 	struct ved_foo foo;
 
-	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
-	CHECK_OBJ_NOTNULL(req->objcore, OBJCORE_MAGIC);
-	CAST_OBJ_NOTNULL(ecx, req->transport_priv, ECX_MAGIC);
+	CHECK_OBJ_ORNULL(req, REQ_MAGIC);
+	CHECK_OBJ_NOTNULL(ecx, ECX_MAGIC);
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	wrk = ecx->preq->wrk;
 
 	INIT_OBJ(&foo, VED_FOO_MAGIC);
 	foo.req = req;
@@ -715,14 +1110,14 @@ ved_stripgzip(struct req *req, const struct boc *boc)
 
 	/* OA_GZIPBITS is not valid until BOS_FINISHED */
 	if (boc != NULL)
-		ObjWaitState(req->objcore, BOS_FINISHED);
-	if (req->objcore->flags & OC_F_FAILED) {
+		ObjWaitState(oc, BOS_FINISHED);
+	if (oc->flags & OC_F_FAILED) {
 		/* No way of signalling errors in the middle of
 		   the ESI body. Omit this ESI fragment. */
 		return;
 	}
 
-	AN(ObjCheckFlag(req->wrk, req->objcore, OF_GZIPED));
+	AN(ObjCheckFlag(wrk, oc, OF_GZIPED));
 
 	/*
 	 * This is the interesting case: Deliver all the deflate
@@ -730,13 +1125,13 @@ ved_stripgzip(struct req *req, const struct boc *boc)
 	 * padding it, as necessary, to a byte boundary.
 	 */
 
-	p = ObjGetAttr(req->wrk, req->objcore, OA_GZIPBITS, &l);
+	p = ObjGetAttr(wrk, oc, OA_GZIPBITS, &l);
 	AN(p);
 	assert(l == 32);
 	foo.start = vbe64dec(p);
 	foo.last = vbe64dec(p + 8);
 	foo.stop = vbe64dec(p + 16);
-	foo.olen = ObjGetLen(req->wrk, req->objcore);
+	foo.olen = ObjGetLen(wrk, oc);
 	assert(foo.start > 0 && foo.start < foo.olen * 8);
 	assert(foo.last > 0 && foo.last < foo.olen * 8);
 	assert(foo.stop > 0 && foo.stop < foo.olen * 8);
@@ -746,10 +1141,7 @@ ved_stripgzip(struct req *req, const struct boc *boc)
 	/* The start bit must be byte aligned. */
 	AZ(foo.start & 7);
 
-	dbits = WS_Alloc(req->ws, 8);
-	AN(dbits);
-	foo.dbits = dbits;
-	(void)ObjIterate(req->wrk, req->objcore, &foo, ved_objiterate, 0);
+	(void)ObjIterate(wrk, oc, &foo, ved_objiterate, 0);
 	/* XXX: error check ?? */
 	(void)ved_bytes(req, foo.preq, VDP_FLUSH, NULL, 0);
 
@@ -793,6 +1185,9 @@ ved_deliver(struct req *req, struct boc *boc, int wantbody)
 
 	CAST_OBJ_NOTNULL(ecx, req->transport_priv, ECX_MAGIC);
 
+	if (ecx->nplan != NULL)
+		ved_plan_add(req, ecx, boc, wantbody);
+
 	if (wantbody == 0)
 		return;
 
@@ -802,7 +1197,7 @@ ved_deliver(struct req *req, struct boc *boc, int wantbody)
 	req->res_mode |= RES_ESI_CHILD;
 	i = ObjCheckFlag(req->wrk, req->objcore, OF_GZIPED);
 	if (ecx->isgzip && i && !(req->res_mode & RES_ESI)) {
-		ved_stripgzip(req, boc);
+		ved_stripgzip(req, ecx, req->objcore, boc);
 	} else {
 		if (ecx->isgzip && !i)
 			VDP_push(req, ved_pretend_gzip, ecx, 1, "PGZ");
@@ -813,3 +1208,54 @@ ved_deliver(struct req *req, struct boc *boc, int wantbody)
 	}
 	VDP_close(req);
 }
+
+/*--------------------------------------------------------------------
+ * Deliver a fragment from the list, as ved_deliver() did when the list
+ * was recorded, charging the bytes to the include request.
+ */
+
+static int
+ved_objiterate_bytes(void *priv, int flush, const void *ptr, ssize_t len)
+{
+	struct req *req;
+	struct ecx *ecx;
+
+	CAST_OBJ_NOTNULL(req, priv, REQ_MAGIC);
+	CAST_OBJ_NOTNULL(ecx, req->transport_priv, ECX_MAGIC);
+	return (ved_bytes(req, ecx->preq, flush ? VDP_FLUSH : VDP_NULL,
+	    ptr, len));
+}
+
+static int
+ved_objiterate_pgz(void *priv, int flush, const void *ptr, ssize_t len)
+{
+	struct req *req;
+	struct ecx *ecx;
+
+	CAST_OBJ_NOTNULL(req, priv, REQ_MAGIC);
+	CAST_OBJ_NOTNULL(ecx, req->transport_priv, ECX_MAGIC);
+	return (ved_pretend_gzip_bytes(req, ecx,
+	    flush ? VDP_FLUSH : VDP_NULL, ptr, len));
+}
+
+static void
+ved_plan_include(struct req *req, struct ecx *ecx, struct objcore *oc)
+{
+	struct worker *wrk;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	CHECK_OBJ_NOTNULL(ecx, ECX_MAGIC);
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	wrk = ecx->preq->wrk;
+
+	if (ObjGetLen(wrk, oc) == 0)
+		return;
+
+	if (!ecx->isgzip)
+		(void)ObjIterate(wrk, oc, req, ved_objiterate_bytes, 0);
+	else if (ObjCheckFlag(wrk, oc, OF_GZIPED))
+		ved_stripgzip(req, ecx, oc, NULL);
+	else
+		(void)ObjIterate(wrk, oc, req, ved_objiterate_pgz, 0);
+	(void)ved_bytes(req, ecx->preq, VDP_FLUSH, NULL, 0);
+}
@@ -343,8 +343,9 @@ vep_mark_common(struct vep_state *vep, const char *p, enum vep_mark mark)
 			vep->crc = vep->crcp;
 			vep->o_crc = vep->o_pending;
 		} else {
-			vep->crc = crc32_combine(vep->crc,
-			    vep->crcp, vep->o_pending);
+			if (vep->dogzip)
+				vep->crc = crc32_combine(vep->crc,
+				    vep->crcp, vep->o_pending);
 			vep->o_crc += vep->o_pending;
 		}
 		vep->crcp = crc32(0L, Z_NULL, 0);
@@ -356,7 +357,9 @@ vep_mark_common(struct vep_state *vep, const char *p, enum vep_mark mark)
 	AN(vep->ver_p);
 	l = p - vep->ver_p;
 	assert(l >= 0);
-	vep->crc = crc32(vep->crc, (const void*)vep->ver_p, l);
+	/* Only gzip'ed ESI objects need the CRCs */
+	if (vep->dogzip)
+		vep->crc = crc32(vep->crc, (const void*)vep->ver_p, l);
 	vep->o_crc += l;
 	vep->ver_p = p;
 
@@ -389,7 +392,8 @@ vep_mark_pending(struct vep_state *vep, const char *p)
 	AN(vep->ver_p);
 	l = p - vep->ver_p;
 	assert(l > 0);
-	vep->crcp = crc32(vep->crcp, (const void *)vep->ver_p, l);
+	if (vep->dogzip)
+		vep->crcp = crc32(vep->crcp, (const void *)vep->ver_p, l);
 	vep->ver_p = p;
 
 	vep->o_pending += l;
@@ -567,7 +571,7 @@ vep_do_include(struct vep_state *vep, enum dowhat what)
 void
 VEP_Parse(struct vep_state *vep, const char *p, size_t l)
 {
-	const char *e;
+	const char *e, *q;
 	struct vep_match *vm;
 	int i;
 
@@ -662,12 +666,12 @@ VEP_Parse(struct vep_state *vep, const char *p, size_t l)
 				vep->state = VEP_NEXTTAG;
 			} else {
 				vep->tag_i = 0;
-				while (p < e) {
-					if (*p++ == '>') {
-						vep->state = VEP_NEXTTAG;
-						break;
-					}
-				}
+				q = memchr(p, '>', e - p);
+				if (q != NULL) {
+					p = q + 1;
+					vep->state = VEP_NEXTTAG;
+				} else
+					p = e;
 			}
 			if (p == e && !vep->remove)
 				vep_mark_verbatim(vep, p);
@@ -675,14 +679,19 @@ VEP_Parse(struct vep_state *vep, const char *p, size_t l)
 			/*
 			 * Hunt for start of next tag and keep an eye
 			 * out for end of EsiCmt if armed.
+			 *
+			 * Most of a body is between tags, so unless
+			 * armed, we let memchr(3) find the next one:
+			 * libc has vector implementations of it.
 			 */
 			vep->emptytag = 0;
 			vep->attr = NULL;
 			vep->dostuff = NULL;
 			while (p < e && *p != '<') {
 				if (vep->esicmt_p == NULL) {
-					p++;
-					continue;
+					q = memchr(p, '<', e - p);
+					p = (q != NULL) ? q : e;
+					break;
 				}
 				if (*p != *vep->esicmt_p) {
 					p++;
@@ -970,8 +979,13 @@ VEP_Parse(struct vep_state *vep, const char *p, size_t l)
 			}
 		} else if (vep->state == VEP_UNTIL) {
 			/*
-			 * Skip until we see magic string
+			 * Skip until we see magic string, in bulk up to
+			 * its first character.
 			 */
+			if (vep->until_p == vep->until) {
+				q = memchr(p, *vep->until, e - p);
+				p = (q != NULL) ? q : e;
+			}
 			while (p < e) {
 				if (*p++ != *vep->until_p++) {
 					vep->until_p = vep->until;
@@ -1097,6 +1111,194 @@ VEP_Finish(struct vep_state *vep)
 	return (NULL);
 }
 
+#ifdef VEP_BENCH_DRIVER
+
+/*
+ * Benchmark for the ESI parser
+ *
+ *	vep_bench [-c chunksize] [-n rounds] [file ...]
+ *
+ * Feeds each file, or synthetic HTML pages without and with ESI markup,
+ * to VEP_Parse() in chunks of the given size, like a fetch does, and
+ * reports how much ESI data comes out and how fast.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "vfil.h"
+#include "vtim.h"
+
+volatile struct params *cache_param;
+struct VSC_C_main *VSC_C_main;
+
+void
+VSLb(struct vsl_log *vsl, enum VSL_tag_e tag, const char *fmt, ...)
+{
+
+	(void)vsl;
+	(void)tag;
+	(void)fmt;
+}
+
+void *
+WS_Alloc(struct ws *ws, unsigned bytes)
+{
+
+	(void)ws;
+	return (calloc(1, bytes));
+}
+
+static char *
+synth_html(size_t len, int esi)
+{
+	static const char * const item[] = {
+		"<div class=\"item\">\n"
+		"  <a href=\"/product/12345\"><img src=\"/i/12345.jpg\""
+		" alt=\"Product\"/></a>\n",
+		"  <p>Lorem ipsum dolor sit amet, consectetur adipiscing"
+		" elit, sed do eiusmod tempor incididunt ut labore et dolore"
+		" magna aliqua. Ut enim ad minim veniam, quis nostrud"
+		" exercitation ullamco laboris nisi ut aliquip ex ea commodo"
+		" consequat.</p>\n",
+		"  <!-- price -->\n  <span class=\"price\">19.99</span>\n",
+		"</div>\n",
+	};
+	static const char incl[] = "<esi:include src=\"/fragment/12345\"/>\n";
+	struct vsb *vsb;
+	char *b;
+	unsigned u;
+
+	vsb = VSB_new_auto();
+	AN(vsb);
+	VSB_cat(vsb, "<html><head><title>Bench</title></head><body>\n");
+	for (u = 0; VSB_len(vsb) < len; u++) {
+		VSB_cat(vsb, item[u % 4]);
+		if (esi && u % 16 == 0)
+			VSB_cat(vsb, incl);
+	}
+	VSB_cat(vsb, "</body></html>\n");
+	AZ(VSB_finish(vsb));
+	b = strdup(VSB_data(vsb));
+	AN(b);
+	VSB_destroy(&vsb);
+	return (b);
+}
+
+static void
+bench(const char *name, const char *b, size_t len, size_t chunk,
+    unsigned rounds)
+{
+	struct vfp_ctx vc;
+	struct http req, beresp;
+	struct worker wrk;
+	struct vep_state *vep;
+	struct vsb *vsb;
+	txt hd[HTTP_HDR_URL + 1];
+	ssize_t esi = 0;
+	size_t o, l;
+	unsigned u;
+	double t;
+
+	INIT_OBJ(&vc, VFP_CTX_MAGIC);
+	INIT_OBJ(&wrk, WORKER_MAGIC);
+	INIT_OBJ(&req, HTTP_MAGIC);
+	INIT_OBJ(&beresp, HTTP_MAGIC);
+	memset(hd, 0, sizeof hd);
+	hd[HTTP_HDR_URL].b = "/";
+	req.hd = hd;
+	vc.wrk = &wrk;
+	vc.http = &beresp;
+
+	t = VTIM_mono();
+	for (u = 0; u < rounds; u++) {
+		vep = VEP_Init(&vc, &req, NULL, NULL);
+		for (o = 0; o < len; o += l) {
+			l = len - o;
+			if (l > chunk)
+				l = chunk;
+			VEP_Parse(vep, b + o, l);
+		}
+		vsb = VEP_Finish(vep);
+		if (vsb != NULL) {
+			esi = VSB_len(vsb);
+			VSB_destroy(&vsb);
+		}
+		free(vep);
+	}
+	t = VTIM_mono() - t;
+
+	printf("%-24s %10zu %10zd %10.1f\n", name, len, esi,
+	    1e-6 * len * rounds / t);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "Usage: vep_bench [-c chunksize] [-n rounds] [file ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char * const *argv)
+{
+	static struct params params;
+	size_t chunk = 16384;
+	unsigned rounds = 50;
+	ssize_t sz;
+	char *b;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "c:n:")) != -1) {
+		switch (ch) {
+		case 'c':
+			chunk = strtoul(optarg, NULL, 0);
+			if (chunk < 1)
+				usage();
+			break;
+		case 'n':
+			rounds = strtoul(optarg, NULL, 0);
+			if (rounds < 1)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	cache_param = &params;
+	VSC_C_main = calloc(1, sizeof *VSC_C_main);
+	AN(VSC_C_main);
+
+	printf("chunks of %zu bytes, %u rounds\n", chunk, rounds);
+	printf("%-24s %10s %10s %10s\n", "body", "bytes", "esidata", "MB/s");
+	if (argc == 0) {
+		b = synth_html(1024 * 1024, 0);
+		bench("synthetic", b, strlen(b), chunk, rounds);
+		free(b);
+		b = synth_html(1024 * 1024, 1);
+		bench("synthetic+esi", b, strlen(b), chunk, rounds);
+		free(b);
+	}
+	for (; argc > 0; argc--, argv++) {
+		b = VFIL_readfile(NULL, *argv, &sz);
+		if (b == NULL) {
+			perror(*argv);
+			exit(1);
+		}
+		if (sz > 0)
+			bench(*argv, b, sz, chunk, rounds);
+		free(b);
+	}
+	return (0);
+}
+
+#endif	/* VEP_BENCH_DRIVER */
+
 #if 0
 
 digraph xml {
@@ -29,9 +29,12 @@
 
 #include "config.h"
 
+#include <poll.h>
+
 #include "cache.h"
 #include "cache_director.h"
 #include "cache_filter.h"
+#include "cache_pool.h"
 #include "hash/hash_slinger.h"
 #include "storage/storage.h"
 #include "vcl.h"
@@ -442,6 +445,13 @@ vbf_stp_startfetch(struct worker *wrk, struct busyobj *bo)
 	bo->vfc->http = bo->beresp;
 	bo->vfc->esi_req = bo->bereq;
 
+	/*
+	 * Fragments of gzip'ed ESI objects are best stored gzip'ed,
+	 * unless vcl_backend_response{} says otherwise.
+	 */
+	if (bo->gzip_fragment)
+		bo->do_gzip = 1;
+
 	VCL_backend_response_method(bo->vcl, wrk, NULL, bo, NULL);
 
 	if (wrk->handling == VCL_RET_ABANDON || wrk->handling == VCL_RET_FAIL) {
@@ -486,6 +496,87 @@ vbf_stp_startfetch(struct worker *wrk, struct busyobj *bo)
 	return (bo->was_304 ? F_STP_CONDFETCH : F_STP_FETCH);
 }
 
+/*--------------------------------------------------------------------
+ * With fetch_park, a body fetch which would block waiting for the
+ * backend gives up its worker thread and waits on the waiter instead,
+ * to carry on in vbf_stp_fetchbody() on whatever thread is available
+ * once there is something to read.
+ *
+ * We only do this when the body goes straight from the connection to
+ * storage: filters like gunzip may hold data which they would produce
+ * without reading any more, and we must not sit on that.
+ */
+
+static int
+vbf_may_park(const struct busyobj *bo)
+{
+	const struct http_conn *htc;
+	struct pollfd pfd[1];
+
+	if (!cache_param->fetch_park)
+		return (0);
+	if (VTAILQ_FIRST(&bo->vfc->vfp) !=
+	    VTAILQ_LAST(&bo->vfc->vfp, vfp_entry_s))
+		return (0);
+	htc = bo->htc;
+	CHECK_OBJ_NOTNULL(htc, HTTP_CONN_MAGIC);
+	if (htc->rfd == NULL || *htc->rfd < 0 || htc->pipeline_b != NULL)
+		return (0);
+	pfd[0].fd = *htc->rfd;
+	pfd[0].events = POLLIN;
+	pfd[0].revents = 0;
+	return (poll(pfd, 1, 0) == 0);
+}
+
+static void  __match_proto__(waiter_handle_f)
+vbf_unpark(struct waited *w, enum wait_event ev, double now)
+{
+	struct busyobj *bo;
+
+	CAST_OBJ_NOTNULL(bo, w->priv1, BUSYOBJ_MAGIC);
+	(void)now;
+	AN(bo->parked);
+	if (ev == WAITER_TIMEOUT || ev == WAITER_CLOSE)
+		bo->park_timeout = 1;
+	AZ(Pool_Task_Any(&bo->fetch_task, TASK_QUEUE_BO));
+}
+
+static enum fetch_step
+vbf_stp_park(struct worker *wrk, struct busyobj *bo)
+{
+	struct waited *w;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	AZ(bo->parked);
+
+	w = bo->waited;
+	INIT_OBJ(w, WAITED_MAGIC);
+	w->fd = *bo->htc->rfd;
+	w->priv1 = bo;
+	w->func = vbf_unpark;
+	w->tmo = &bo->htc->between_bytes_timeout;
+	w->idle = VTIM_real();
+
+	/* Once the waiter has it, the busyobj is not ours any more */
+	bo->parked = 1;
+	bo->wrk = NULL;
+	bo->vfc->wrk = NULL;
+	wrk->vsl = NULL;
+	THR_SetBusyobj(NULL);
+	if (Wait_Enter(wrk->pool->waiter, w) == 0) {
+		wrk->stats->fetch_parked++;
+		return (F_STP_NONE);
+	}
+
+	bo->parked = 0;
+	bo->wrk = wrk;
+	bo->vfc->wrk = wrk;
+	wrk->vsl = bo->vsl;
+	THR_SetBusyobj(bo);
+	return (F_STP_FETCHBODY);
+}
+
 /*--------------------------------------------------------------------
  */
 
@@ -497,6 +588,7 @@ vbf_stp_fetchbody(struct worker *wrk, struct busyobj *bo)
 	enum vfp_status vfps = VFP_ERROR;
 	ssize_t est;
 	struct vfp_ctx *vfc;
+	int may_park = 0;
 
 	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
 	vfc = bo->vfc;
@@ -504,11 +596,24 @@ vbf_stp_fetchbody(struct worker *wrk, struct busyobj *bo)
 
 	AN(vfc->vfp_nxt);
 
-	est = bo->htc->content_length;
+	if (bo->park_timeout) {
+		bo->park_timeout = 0;
+		(void)VFP_Error(vfc, "Backend body timed out while parked");
+		bo->htc->doclose = SC_RX_TIMEOUT;
+	}
+
+	est = bo->htc->content_length - bo->fetch_objcore->boc->len_so_far;
 	if (est < 0)
 		est = 0;
 
-	do {
+	/*
+	 * We never park before the first read, which is also what keeps
+	 * us from coming straight back if the waiter would not have us.
+	 */
+	while (!vfc->failed) {
+		if (may_park && vbf_may_park(bo))
+			return (F_STP_PARK);
+		may_park = 1;
 		if (vfc->oc->flags & OC_F_ABANDON) {
 			/*
 			 * A pass object and delivery was terminated
@@ -540,7 +645,9 @@ vbf_stp_fetchbody(struct worker *wrk, struct busyobj *bo)
 			else
 				est = 0;
 		}
-	} while (vfps == VFP_OK);
+		if (vfps != VFP_OK)
+			break;
+	}
 
 	if (vfc->failed) {
 		(void)VFP_Error(vfc, "Fetch pipeline failed to process");
@@ -646,6 +753,14 @@ vbf_stp_fetch(struct worker *wrk, struct busyobj *bo)
 		}
 	}
 
+#ifdef HAVE_BROTLI
+	/* The brotli copy is made from what goes into storage */
+	if (bo->do_brotli && !bo->do_esi && !bo->uncacheable &&
+	    bo->htc->body_status != BS_NONE &&
+	    bo->htc->content_length != 0)
+		vbf_vfp_push(bo, &vfp_brotli, 1);
+#endif
+
 	if (bo->fetch_objcore->flags & OC_F_PRIVATE)
 		AN(bo->uncacheable);
 
@@ -786,6 +901,10 @@ vbf_stp_condfetch(struct worker *wrk, struct busyobj *bo)
 		AZ(ObjCopyAttr(bo->wrk, bo->fetch_objcore, bo->stale_oc,
 		    OA_ESIDATA));
 
+	if (ObjHasAttr(bo->wrk, bo->stale_oc, OA_BRBODY))
+		(void)ObjCopyAttr(bo->wrk, bo->fetch_objcore, bo->stale_oc,
+		    OA_BRBODY);
+
 	AZ(ObjCopyAttr(bo->wrk, bo->fetch_objcore, bo->stale_oc, OA_FLAGS));
 	AZ(ObjCopyAttr(bo->wrk, bo->fetch_objcore, bo->stale_oc, OA_GZIPBITS));
 
@@ -947,17 +1066,27 @@ vbf_fetch_thread(struct worker *wrk, void *priv)
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CAST_OBJ_NOTNULL(bo, priv, BUSYOBJ_MAGIC);
-	CHECK_OBJ_NOTNULL(bo->req, REQ_MAGIC);
 	CHECK_OBJ_NOTNULL(bo->fetch_objcore, OBJCORE_MAGIC);
 
 	THR_SetBusyobj(bo);
-	stp = F_STP_MKBEREQ;
-	assert(isnan(bo->t_first));
-	assert(isnan(bo->t_prev));
-	VSLb_ts_busyobj(bo, "Start", W_TIM_real(wrk));
-
-	bo->wrk = wrk;
-	wrk->vsl = bo->vsl;
+	if (bo->parked) {
+		/* Back from the waiter, see vbf_stp_park() */
+		AZ(bo->wrk);
+		bo->parked = 0;
+		bo->wrk = wrk;
+		bo->vfc->wrk = wrk;
+		wrk->vsl = bo->vsl;
+		stp = F_STP_FETCHBODY;
+	} else {
+		CHECK_OBJ_NOTNULL(bo->req, REQ_MAGIC);
+		stp = F_STP_MKBEREQ;
+		assert(isnan(bo->t_first));
+		assert(isnan(bo->t_prev));
+		VSLb_ts_busyobj(bo, "Start", W_TIM_real(wrk));
+
+		bo->wrk = wrk;
+		wrk->vsl = bo->vsl;
+	}
 
 #if 0
 	if (bo->stale_oc != NULL) {
@@ -980,6 +1109,8 @@ vbf_fetch_thread(struct worker *wrk, void *priv)
 		default:
 			WRONG("Illegal fetch_step");
 		}
+		if (stp == F_STP_NONE)
+			return;		/* Parked, hands off the busyobj */
 	}
 
 	assert(bo->director_state == DIR_S_NULL);
@@ -1064,6 +1195,8 @@ VBF_Fetch(struct worker *wrk, struct req *req, struct objcore *oc,
 
 	AZ(bo->req);
 	bo->req = req;
+	bo->gzip_fragment = cache_param->gzip_esi_fragments &&
+	    req->esi_level > 0 && RFC2616_Req_Gzip(req->http0);
 
 	bo->fetch_task.priv = bo;
 	bo->fetch_task.func = vbf_fetch_thread;
@@ -73,6 +73,7 @@ extern const struct vfp vfp_gzip;
 extern const struct vfp vfp_testgunzip;
 extern const struct vfp vfp_esi;
 extern const struct vfp vfp_esi_gzip;
+extern const struct vfp vfp_brotli;
 
 struct vfp_entry *VFP_Push(struct vfp_ctx *, const struct vfp *, int top);
 void VFP_Setup(struct vfp_ctx *vc);
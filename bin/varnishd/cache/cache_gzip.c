@@ -61,6 +61,8 @@ struct vgz {
 
 	intmax_t		bits;
 
+	struct vgzp		*par;
+
 	z_stream		vz;
 };
 
@@ -96,7 +98,7 @@ vgz_gunzip(struct vsl_log *vsl, const char *id)
 	return (vg);
 }
 
-static struct vgz *
+struct vgz *
 VGZ_NewGunzip(struct vsl_log *vsl, const char *id)
 {
 	VSC_C_main->n_gunzip++;
@@ -207,7 +209,7 @@ VGZ_ObufFull(const struct vgz *vg)
 
 /*--------------------------------------------------------------------*/
 
-static enum vgzret_e
+enum vgzret_e
 VGZ_Gunzip(struct vgz *vg, const void **pptr, ssize_t *plen)
 {
 	int i;
@@ -387,6 +389,355 @@ VGZ_UpdateObj(const struct vfp_ctx *vc, struct vgz *vg, enum vgz_ua_e e)
 		vbe64enc(p + 24, vg->vz.total_out);
 }
 
+/*--------------------------------------------------------------------
+ * Parallel gzip
+ *
+ * Large bodies are cut into VGZP_BLKSZ blocks which helper workers
+ * compress as raw deflate, each primed with the tail of the previous
+ * block as dictionary, pigz style.  All but the last block end in a
+ * sync flush, so their output concatenates into one deflate stream,
+ * for which we write the gzip header and trailer ourselves.
+ *
+ * The fetch thread compresses any block no helper has picked up by
+ * the time it is needed, so we never wait for a worker thread.
+ *
+ * Up to VGZP_NBLK blocks are in flight, but no more than it takes to
+ * hold the Content-Length, so smaller bodies use less memory.
+ */
+
+#define VGZP_BLKSZ	(128 * 1024)
+#define VGZP_DICTSZ	(32 * 1024)
+#define VGZP_OUTSZ	(VGZP_BLKSZ + (VGZP_BLKSZ >> 10) + 64)
+#define VGZP_NBLK	8
+
+struct vgzp_blk {
+	enum {
+		VGZP_FREE = 0,
+		VGZP_READY,
+		VGZP_BUSY,
+		VGZP_DONE
+	}			state;
+	int			last;
+	uint8_t			*in;
+	ssize_t			in_len;
+	uint8_t			*dict;
+	ssize_t			dict_len;
+	uint8_t			*out;
+	ssize_t			out_len;
+	uLong			crc;
+	uLong			last_bit;
+	uLong			stop_bit;
+};
+
+struct vgzp {
+	unsigned		magic;
+#define VGZP_MAGIC		0x5b1f6e3a
+	struct lock		mtx;
+	pthread_cond_t		cond;
+	unsigned		refcnt;
+	unsigned		nhelp;		/* Helpers not yet started */
+	int			level;
+	int			memlevel;
+	unsigned		nblk;		/* Power of two */
+
+	/* Owned by the fetch thread */
+	unsigned		nxt_in;
+	unsigned		nxt_out;
+	int			eof;
+	int			emitting;
+	int			fin;
+	const uint8_t		*op;
+	ssize_t			ol;
+	uLong			crc;
+	uintmax_t		len_in;
+	uintmax_t		len_out;
+	uint8_t			tail[8];
+
+	uint8_t			*mem;
+	struct vgzp_blk		blk[VGZP_NBLK];
+};
+
+struct vgzp_task {
+	unsigned		magic;
+#define VGZP_TASK_MAGIC		0x0c5e9d21
+	struct pool_task	task;
+	struct vgzp		*vp;
+};
+
+static const uint8_t vgzp_hdr[10] = {
+	0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3
+};
+
+static struct vgzp *
+vgzp_new(ssize_t cl)
+{
+	struct vgzp *vp;
+	struct vgzp_blk *blk;
+	uint8_t *p;
+	unsigned u;
+
+	ALLOC_OBJ(vp, VGZP_MAGIC);
+	if (vp == NULL)
+		return (NULL);
+	vp->nblk = 1;
+	while (vp->nblk < VGZP_NBLK && vp->nblk * (ssize_t)VGZP_BLKSZ < cl)
+		vp->nblk <<= 1;
+	vp->mem = malloc(vp->nblk *
+	    (VGZP_BLKSZ + VGZP_DICTSZ + VGZP_OUTSZ));
+	if (vp->mem == NULL) {
+		FREE_OBJ(vp);
+		return (NULL);
+	}
+	p = vp->mem;
+	for (u = 0; u < vp->nblk; u++) {
+		blk = &vp->blk[u];
+		blk->in = p;
+		p += VGZP_BLKSZ;
+		blk->dict = p;
+		p += VGZP_DICTSZ;
+		blk->out = p;
+		p += VGZP_OUTSZ;
+	}
+	Lck_New(&vp->mtx, lck_gzip);
+	AZ(pthread_cond_init(&vp->cond, NULL));
+	vp->refcnt = 1;
+	vp->level = cache_param->gzip_level;
+	vp->memlevel = cache_param->gzip_memlevel;
+	vp->crc = crc32(0L, Z_NULL, 0);
+	vp->op = vgzp_hdr;
+	vp->ol = sizeof vgzp_hdr;
+	return (vp);
+}
+
+static void
+vgzp_release(struct vgzp **vpp)
+{
+	struct vgzp *vp;
+	unsigned r;
+
+	TAKE_OBJ_NOTNULL(vp, vpp, VGZP_MAGIC);
+	Lck_Lock(&vp->mtx);
+	assert(vp->refcnt > 0);
+	r = --vp->refcnt;
+	Lck_Unlock(&vp->mtx);
+	if (r > 0)
+		return;
+	Lck_Delete(&vp->mtx);
+	AZ(pthread_cond_destroy(&vp->cond));
+	free(vp->mem);
+	FREE_OBJ(vp);
+}
+
+static void
+vgzp_compress(const struct vgzp *vp, struct vgzp_blk *blk)
+{
+	z_stream vz;
+	int i;
+
+	memset(&vz, 0, sizeof vz);
+	i = deflateInit2(&vz, vp->level, Z_DEFLATED, -15, vp->memlevel,
+	    Z_DEFAULT_STRATEGY);
+	assert(i == Z_OK);
+	if (blk->dict_len > 0)
+		AZ(deflateSetDictionary(&vz, blk->dict, blk->dict_len));
+	vz.next_in = blk->in;
+	vz.avail_in = blk->in_len;
+	vz.next_out = blk->out;
+	vz.avail_out = VGZP_OUTSZ;
+	i = deflate(&vz, blk->last ? Z_FINISH : Z_SYNC_FLUSH);
+	assert(i == (blk->last ? Z_STREAM_END : Z_OK));
+	AZ(vz.avail_in);
+	AN(vz.avail_out);
+	blk->out_len = VGZP_OUTSZ - vz.avail_out;
+	blk->last_bit = vz.last_bit;
+	blk->stop_bit = vz.stop_bit;
+	blk->crc = crc32(0L, blk->in, blk->in_len);
+	(void)deflateEnd(&vz);
+}
+
+/* Claim and compress ready blocks, oldest first */
+
+static void
+vgzp_work(struct vgzp *vp)
+{
+	struct vgzp_blk *blk;
+	unsigned u;
+
+	Lck_AssertHeld(&vp->mtx);
+	for (u = vp->nxt_out; u != vp->nxt_in; u++) {
+		blk = &vp->blk[u % vp->nblk];
+		if (blk->state != VGZP_READY)
+			continue;
+		blk->state = VGZP_BUSY;
+		Lck_Unlock(&vp->mtx);
+		vgzp_compress(vp, blk);
+		Lck_Lock(&vp->mtx);
+		blk->state = VGZP_DONE;
+		AZ(pthread_cond_broadcast(&vp->cond));
+	}
+}
+
+static void __match_proto__(task_func_t)
+vgzp_helper(struct worker *wrk, void *priv)
+{
+	struct vgzp_task *vt;
+	struct vgzp *vp;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CAST_OBJ_NOTNULL(vt, priv, VGZP_TASK_MAGIC);
+	vp = vt->vp;
+	FREE_OBJ(vt);
+	CHECK_OBJ_NOTNULL(vp, VGZP_MAGIC);
+
+	Lck_Lock(&vp->mtx);
+	AN(vp->nhelp);
+	vp->nhelp--;
+	if (vp->refcnt > 1)
+		vgzp_work(vp);
+	Lck_Unlock(&vp->mtx);
+	vgzp_release(&vp);
+}
+
+/*
+ * Ask for a helper, unless one is already on its way.  If the pool
+ * has no room for it, the fetch thread will do the work itself.
+ */
+
+static void
+vgzp_dispatch(struct worker *wrk, struct vgzp *vp)
+{
+	struct vgzp_task *vt;
+
+	Lck_AssertHeld(&vp->mtx);
+	if (vp->nhelp > 0)
+		return;
+	ALLOC_OBJ(vt, VGZP_TASK_MAGIC);
+	if (vt == NULL)
+		return;
+	vt->vp = vp;
+	vt->task.func = vgzp_helper;
+	vt->task.priv = vt;
+	vp->refcnt++;
+	vp->nhelp++;
+	if (Pool_Task(wrk->pool, &vt->task, TASK_QUEUE_REQ)) {
+		vp->refcnt--;
+		vp->nhelp--;
+		FREE_OBJ(vt);
+	}
+}
+
+static enum vfp_status
+vgzp_fill(struct vfp_ctx *vc, struct vgzp *vp)
+{
+	struct vgzp_blk *blk, *prev;
+	enum vfp_status vs = VFP_OK;
+	ssize_t l;
+
+	while (!vp->eof && vp->nxt_in - vp->nxt_out < vp->nblk) {
+		blk = &vp->blk[vp->nxt_in % vp->nblk];
+		assert(blk->state == VGZP_FREE);
+		blk->in_len = 0;
+		do {
+			l = VGZP_BLKSZ - blk->in_len;
+			vs = VFP_Suck(vc, blk->in + blk->in_len, &l);
+			if (vs == VFP_ERROR)
+				return (vs);
+			blk->in_len += l;
+		} while (vs == VFP_OK && blk->in_len < VGZP_BLKSZ);
+		blk->last = vp->eof = (vs == VFP_END);
+
+		blk->dict_len = 0;
+		if (vp->nxt_in > 0) {
+			prev = &vp->blk[(vp->nxt_in - 1) % vp->nblk];
+			blk->dict_len = prev->in_len;
+			if (blk->dict_len > VGZP_DICTSZ)
+				blk->dict_len = VGZP_DICTSZ;
+			memcpy(blk->dict, prev->in + prev->in_len -
+			    blk->dict_len, blk->dict_len);
+		}
+		Lck_Lock(&vp->mtx);
+		blk->state = VGZP_READY;
+		vp->nxt_in++;
+		vgzp_dispatch(vc->wrk, vp);
+		Lck_Unlock(&vp->mtx);
+	}
+	return (VFP_OK);
+}
+
+static enum vfp_status
+vgzp_pull(struct vfp_ctx *vc, struct vgz *vg, uint8_t *p, ssize_t *lp)
+{
+	struct vgzp *vp;
+	struct vgzp_blk *blk;
+	ssize_t l;
+	uintmax_t u;
+
+	CAST_OBJ_NOTNULL(vp, vg->par, VGZP_MAGIC);
+	l = *lp;
+	*lp = 0;
+	while (1) {
+		if (vp->ol > 0) {
+			if (l > vp->ol)
+				l = vp->ol;
+			memcpy(p, vp->op, l);
+			vp->op += l;
+			vp->ol -= l;
+			vp->len_out += l;
+			*lp = l;
+			return (VFP_OK);
+		}
+		if (vp->emitting) {
+			/* Done with the oldest block */
+			blk = &vp->blk[vp->nxt_out % vp->nblk];
+			vp->emitting = 0;
+			Lck_Lock(&vp->mtx);
+			blk->state = VGZP_FREE;
+			vp->nxt_out++;
+			Lck_Unlock(&vp->mtx);
+			if (blk->last) {
+				vle32enc(vp->tail, vp->crc);
+				vle32enc(vp->tail + 4, (uint32_t)vp->len_in);
+				vp->op = vp->tail;
+				vp->ol = sizeof vp->tail;
+				vp->fin = 1;
+				continue;
+			}
+		}
+		if (vp->fin) {
+			vg->vz.total_in = vp->len_in;
+			vg->vz.total_out = vp->len_out;
+			VGZ_UpdateObj(vc, vg, VUA_END_GZIP);
+			vg->last_i = Z_STREAM_END;
+			return (VFP_END);
+		}
+		if (vgzp_fill(vc, vp) == VFP_ERROR)
+			return (VFP_Error(vc, "Gzip failed"));
+		assert(vp->nxt_in != vp->nxt_out);
+
+		blk = &vp->blk[vp->nxt_out % vp->nblk];
+		Lck_Lock(&vp->mtx);
+		while (blk->state != VGZP_DONE) {
+			if (blk->state == VGZP_READY)
+				vgzp_work(vp);
+			else
+				(void)Lck_CondWait(&vp->cond, &vp->mtx, 0);
+		}
+		Lck_Unlock(&vp->mtx);
+
+		vp->crc = crc32_combine(vp->crc, blk->crc, blk->in_len);
+		vp->len_in += blk->in_len;
+		if (blk->last) {
+			u = vp->len_out * 8;
+			vg->vz.start_bit = sizeof vgzp_hdr * 8;
+			vg->vz.last_bit = u + blk->last_bit;
+			vg->vz.stop_bit = u + blk->stop_bit;
+		}
+		vp->op = blk->out;
+		vp->ol = blk->out_len;
+		vp->emitting = 1;
+	}
+}
+
 /*--------------------------------------------------------------------
  */
 
@@ -409,7 +760,10 @@ VGZ_Destroy(struct vgz **vgp)
 	    (intmax_t)vg->vz.start_bit,
 	    (intmax_t)vg->vz.last_bit,
 	    (intmax_t)vg->vz.stop_bit);
-	if (vg->dir == VGZ_GZ)
+	if (vg->par != NULL) {
+		vgzp_release(&vg->par);
+		i = Z_OK;		/* vg->vz ended in vfp_gzip_init() */
+	} else if (vg->dir == VGZ_GZ)
 		i = deflateEnd(&vg->vz);
 	else
 		i = inflateEnd(&vg->vz);
@@ -442,6 +796,7 @@ static enum vfp_status __match_proto__(vfp_init_f)
 vfp_gzip_init(struct vfp_ctx *vc, struct vfp_entry *vfe)
 {
 	struct vgz *vg;
+	ssize_t cl;
 
 	CHECK_OBJ_NOTNULL(vc, VFP_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(vfe, VFP_ENTRY_MAGIC);
@@ -455,6 +810,16 @@ vfp_gzip_init(struct vfp_ctx *vc, struct vfp_entry *vfe)
 		if (http_GetHdr(vc->http, H_Content_Encoding, NULL))
 			return (VFP_NULL);
 		vg = VGZ_NewGzip(vc->wrk->vsl, vfe->vfp->priv1);
+		cl = http_GetContentLength(vc->http);
+		if (vg != NULL && cache_param->gzip_parallel > 0 &&
+		    cl >= cache_param->gzip_parallel) {
+			vg->par = vgzp_new(cl);
+			if (vg->par != NULL) {
+				/* vgzp_pull() makes its own deflate streams */
+				AZ(deflateEnd(&vg->vz));
+				VSC_C_main->n_gzip_parallel++;
+			}
+		}
 	} else {
 		if (!http_HdrIs(vc->http, H_Content_Encoding, "gzip"))
 			return (VFP_NULL);
@@ -466,10 +831,12 @@ vfp_gzip_init(struct vfp_ctx *vc, struct vfp_entry *vfe)
 	if (vg == NULL)
 		return (VFP_ERROR);
 	vfe->priv1 = vg;
-	if (vgz_getmbuf(vg))
-		return (VFP_ERROR);
-	VGZ_Ibuf(vg, vg->m_buf, 0);
-	AZ(vg->m_len);
+	if (vg->par == NULL) {
+		if (vgz_getmbuf(vg))
+			return (VFP_ERROR);
+		VGZ_Ibuf(vg, vg->m_buf, 0);
+		AZ(vg->m_len);
+	}
 
 	if (vfe->vfp->priv2 == VFP_GUNZIP || vfe->vfp->priv2 == VFP_GZIP) {
 		http_Unset(vc->http, H_Content_Encoding);
@@ -562,6 +929,8 @@ vfp_gzip_pull(struct vfp_ctx *vc, struct vfp_entry *vfe, void *p,
 	CAST_OBJ_NOTNULL(vg, vfe->priv1, VGZ_MAGIC);
 	AN(p);
 	AN(lp);
+	if (vg->par != NULL)
+		return (vgzp_pull(vc, vg, p, lp));
 	l = *lp;
 	*lp = 0;
 	VGZ_Obuf(vg, p, l);
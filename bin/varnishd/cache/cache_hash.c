@@ -331,16 +331,18 @@ hsh_insert_busyobj(struct worker *wrk, struct objhead *oh)
 }
 
 /*---------------------------------------------------------------------
+ * With HSH_EXP, *busyp, if given, gets a reference to the object being
+ * fetched by someone else.
  */
 
 enum lookup_e
 HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
-    int always_insert)
+    struct objcore **busyp, int always_insert)
 {
 	struct worker *wrk;
 	struct objhead *oh;
 	struct objcore *oc;
-	struct objcore *exp_oc;
+	struct objcore *exp_oc, *busy_oc;
 	double exp_t_origin;
 	int busy_found;
 	enum lookup_e retval;
@@ -350,6 +352,8 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 	*ocp = NULL;
 	AN(bocp);
 	*bocp = NULL;
+	if (busyp != NULL)
+		*busyp = NULL;
 
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 	wrk = req->wrk;
@@ -361,6 +365,35 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 	if (DO_DEBUG(DBG_HASHEDGE))
 		hsh_testmagic(req->digest);
 
+	if (req->hash_oc != NULL) {
+		/*
+		 * This req was handed the object it waited for by
+		 * HSH_Unbusy(), along with a reference to it.  If it
+		 * has been banned since, trade that for a reference to
+		 * the objhead, and look it up properly.
+		 */
+		TAKE_OBJ_NOTNULL(oc, &req->hash_oc, OBJCORE_MAGIC);
+		AZ(req->hash_objhead);
+		AZ(always_insert);
+		oh = oc->objhead;
+		CHECK_OBJ_NOTNULL(oh, OBJHEAD_MAGIC);
+		Lck_Lock(&oh->mtx);
+		if (!(oc->flags & OC_F_DYING) &&
+		    BAN_CheckObject(wrk, oc, req)) {
+			oc->flags |= OC_F_DYING;
+			EXP_Remove(oc);
+		}
+		if (!(oc->flags & OC_F_DYING)) {
+			Lck_Unlock(&oh->mtx);
+			*ocp = oc;
+			return (HSH_HIT);
+		}
+		oh->refcnt++;
+		Lck_Unlock(&oh->mtx);
+		(void)HSH_DerefObjCore(wrk, &oc, 0);
+		req->hash_objhead = oh;
+	}
+
 	if (req->hash_objhead != NULL) {
 		/*
 		 * This req came off the waiting list, and brings an
@@ -389,6 +422,7 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 
 	assert(oh->refcnt > 0);
 	busy_found = 0;
+	busy_oc = NULL;
 	exp_oc = NULL;
 	exp_t_origin = 0.0;
 	VTAILQ_FOREACH(oc, &oh->objcs, hsh_list) {
@@ -414,6 +448,8 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 				continue;
 
 			busy_found = 1;
+			if (busy_oc == NULL)
+				busy_oc = oc;
 			continue;
 		}
 
@@ -484,6 +520,11 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 		} else {
 			AZ(req->hash_ignore_busy);
 			retval = HSH_EXP;
+			if (busyp != NULL) {
+				CHECK_OBJ_NOTNULL(busy_oc, OBJCORE_MAGIC);
+				busy_oc->refcnt++;
+				*busyp = busy_oc;
+			}
 		}
 		if (exp_oc->hits < LONG_MAX)
 			exp_oc->hits++;
@@ -502,6 +543,13 @@ HSH_Lookup(struct req *req, struct objcore **ocp, struct objcore **bocp,
 		return (HSH_MISS);
 	}
 
+	if (req->esi_prefetch) {
+		/* Already being fetched, which is all we wanted */
+		Lck_Unlock(&oh->mtx);
+		assert(HSH_DerefObjHead(wrk, &oh));
+		return (HSH_MISS);
+	}
+
 	/* There are one or more busy objects, wait for them */
 
 	AZ(req->hash_ignore_busy);
@@ -557,6 +605,58 @@ hsh_rush1(struct worker *wrk, struct objhead *oh, struct rush *r, int max)
 	}
 }
 
+/*---------------------------------------------------------------------
+ * Hand a freshly unbusied object to all the req's on the waiting list
+ * which would find it anyway, so they need not come back and look it
+ * up under the objhead lock one rush_exponent wave at a time.
+ *
+ * Each req trades its objhead reference for one on the objcore, which
+ * holds its own reference to the objhead.  Vary'ed objects and req's
+ * with their own TTL rules go through the ordinary rush.  Bans are
+ * checked when the req picks the object up in HSH_Lookup().
+ */
+
+static void
+hsh_handoff(struct worker *wrk, struct objhead *oh, struct objcore *oc,
+    int vary, struct rush *r)
+{
+	struct req *req, *req2;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(oh, OBJHEAD_MAGIC);
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	CHECK_OBJ_NOTNULL(r, RUSH_MAGIC);
+	Lck_AssertHeld(&oh->mtx);
+	VTAILQ_INIT(&r->reqs);
+
+	if (oc->flags & (OC_F_PRIVATE | OC_F_HFP | OC_F_PASS | OC_F_FAILED))
+		return;
+	if (oc->ttl <= 0. || vary)
+		return;
+
+	VTAILQ_FOREACH_SAFE(req, &oh->waitinglist, w_list, req2) {
+		CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+		AZ(req->wrk);
+		assert(req->hash_objhead == oh);
+		if (req->d_ttl >= 0.)
+			continue;
+		if (EXP_Ttl(req, oc) < req->t_req)
+			continue;
+		wrk->stats->busy_wakeup++;
+		wrk->stats->busy_handoff++;
+		VTAILQ_REMOVE(&oh->waitinglist, req, w_list);
+		VTAILQ_INSERT_TAIL(&r->reqs, req, w_list);
+		req->waitinglist = 0;
+		assert(oh->refcnt > 1);
+		oh->refcnt--;
+		req->hash_objhead = NULL;
+		oc->refcnt++;
+		if (oc->hits < LONG_MAX)
+			oc->hits++;
+		req->hash_oc = oc;
+	}
+}
+
 /*---------------------------------------------------------------------
  * Rush req's that came from waiting list.
  */
@@ -692,13 +792,15 @@ void
 HSH_Unbusy(struct worker *wrk, struct objcore *oc)
 {
 	struct objhead *oh;
-	struct rush rush;
+	struct rush rush, handoff;
+	int vary;
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
 	oh = oc->objhead;
 	CHECK_OBJ(oh, OBJHEAD_MAGIC);
 	INIT_OBJ(&rush, RUSH_MAGIC);
+	INIT_OBJ(&handoff, RUSH_MAGIC);
 
 	AN(oc->stobj->stevedore);
 	AN(oc->flags & OC_F_BUSY);
@@ -710,6 +812,8 @@ HSH_Unbusy(struct worker *wrk, struct objcore *oc)
 		AN(oc->ban);
 	}
 
+	vary = ObjHasAttr(wrk, oc, OA_VARY);
+
 	/* XXX: pretouch neighbors on oh->objcs to prevent page-on under mtx */
 	Lck_Lock(&oh->mtx);
 	assert(oh->refcnt > 0);
@@ -720,11 +824,14 @@ HSH_Unbusy(struct worker *wrk, struct objcore *oc)
 	VTAILQ_REMOVE(&oh->objcs, oc, hsh_list);
 	VTAILQ_INSERT_HEAD(&oh->objcs, oc, hsh_list);
 	oc->flags &= ~OC_F_BUSY;
+	if (!VTAILQ_EMPTY(&oh->waitinglist))
+		hsh_handoff(wrk, oh, oc, vary, &handoff);
 	if (!VTAILQ_EMPTY(&oh->waitinglist))
 		hsh_rush1(wrk, oh, &rush, HSH_RUSH_POLICY);
 	Lck_Unlock(&oh->mtx);
 	if (!(oc->flags & OC_F_PRIVATE))
 		EXP_Insert(wrk, oc);
+	hsh_rush2(wrk, &handoff);
 	hsh_rush2(wrk, &rush);
 }
 
@@ -747,6 +854,47 @@ HSH_Kill(struct objcore *oc)
 	EXP_Remove(oc);
 }
 
+/*====================================================================
+ * HSH_Current()
+ *
+ * Would a lookup still find this object, Vary aside: it is not dead,
+ * fresh at the given time, has seen all bans, and no newer object has
+ * been inserted in front of it.
+ */
+
+int
+HSH_Current(struct objcore *oc, double now)
+{
+	struct objhead *oh;
+	struct objcore *oc2;
+	int r = 0;
+
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+	oh = oc->objhead;
+	CHECK_OBJ_NOTNULL(oh, OBJHEAD_MAGIC);
+
+	Lck_Lock(&oh->mtx);
+	VTAILQ_FOREACH(oc2, &oh->objcs, hsh_list) {
+		if (oc2 == oc)
+			break;
+		if (oc2->flags & (OC_F_DYING | OC_F_FAILED))
+			continue;
+		if (oc2->boc != NULL && oc2->boc->state < BOS_STREAM)
+			continue;
+		if (oc2->ttl <= 0.)
+			continue;
+		break;
+	}
+	if (oc2 == oc && !(oc->flags & (OC_F_DYING | OC_F_FAILED)) &&
+	    oc->ttl > 0. && EXP_Ttl(NULL, oc) >= now && BAN_Current(oc)) {
+		if (oc->hits < LONG_MAX)
+			oc->hits++;
+		r = 1;
+	}
+	Lck_Unlock(&oh->mtx);
+	return (r);
+}
+
 /*====================================================================
  * HSH_Snipe()
  *
@@ -885,6 +1033,9 @@ HSH_DerefObjCore(struct worker *wrk, struct objcore **ocp, int rushmax)
 
 	AZ(oc->exp_flags);
 
+	if (oc->esi_plan != NULL)
+		VED_Free(wrk, oc);
+
 	BAN_DestroyObj(oc);
 	AZ(oc->ban);
 
@@ -267,7 +267,7 @@ http_PutField(struct http *to, int field, const char *string)
 
 /*--------------------------------------------------------------------*/
 
-static int
+int
 http_IsHdr(const txt *hh, const char *hdr)
 {
 	unsigned l;
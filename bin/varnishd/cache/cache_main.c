@@ -247,6 +247,7 @@ child_main(void)
 	EXP_Init();
 	HSH_Init(heritage.hash);
 	BAN_Init();
+	VED_Init();
 
 	VCA_Init();
 
@@ -66,6 +66,8 @@
  * 23	  ObjGetXID()
  *
  * 23	ObjIterate()	... over body
+ * 23	ObjIterateOffset() ... over the body from an offset
+ * 3	ObjSendfile()	... over body, as (fd, offset, length)
  *
  * 23	ObjTouch()	Signal to LRU(-like) facilities
  *
@@ -177,12 +179,51 @@ int
 ObjIterate(struct worker *wrk, struct objcore *oc,
     void *priv, objiterate_f *func, int final)
 {
+
+	return (ObjIterateOffset(wrk, oc, 0, priv, func, final));
+}
+
+/*====================================================================
+ * ObjIterateOffset()
+ *
+ * Like ObjIterate(), but the first off bytes of the body are skipped
+ * without being looked at.  If the body is still being fetched, we
+ * wait until it gets past off.
+ */
+
+int
+ObjIterateOffset(struct worker *wrk, struct objcore *oc, ssize_t off,
+    void *priv, objiterate_f *func, int final)
+{
 	const struct obj_methods *om = obj_getmethods(oc);
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	AN(func);
+	assert(off >= 0);
 	AN(om->objiterator);
-	return (om->objiterator(wrk, oc, priv, func, final));
+	return (om->objiterator(wrk, oc, off, priv, func, final));
+}
+
+/*====================================================================
+ * ObjSendfile()
+ *
+ * Like ObjIterate(), but presents the body as file descriptor, offset
+ * and length of the storage holding it, for use with sendfile(2).
+ *
+ * Returns 1 without calling func if the stevedore cannot do that.
+ */
+
+int
+ObjSendfile(struct worker *wrk, struct objcore *oc,
+    void *priv, objsendfile_f *func)
+{
+	const struct obj_methods *om = obj_getmethods(oc);
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	AN(func);
+	if (om->objfileiterator == NULL)
+		return (1);
+	return (om->objfileiterator(wrk, oc, priv, func));
 }
 
 /*====================================================================
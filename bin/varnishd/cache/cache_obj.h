@@ -34,8 +34,10 @@ typedef void objfree_f(struct worker *, struct objcore *);
 typedef void objsetstate_f(struct worker *, const struct objcore *,
     enum boc_state_e);
 
-typedef int objiterator_f(struct worker *, struct objcore *,
+typedef int objiterator_f(struct worker *, struct objcore *, ssize_t off,
     void *priv, objiterate_f *func, int final);
+typedef int objfileiterator_f(struct worker *, struct objcore *,
+    void *priv, objsendfile_f *func);
 typedef int objgetspace_f(struct worker *, struct objcore *,
      ssize_t *sz, uint8_t **ptr);
 typedef void objextend_f(struct worker *, struct objcore *, ssize_t l);
@@ -51,6 +53,7 @@ typedef void objtouch_f(struct worker *, struct objcore *, double now);
 struct obj_methods {
 	objfree_f	*objfree;
 	objiterator_f	*objiterator;
+	objfileiterator_f	*objfileiterator;
 	objgetspace_f	*objgetspace;
 	objextend_f	*objextend;
 	objtrimstore_f	*objtrimstore;
@@ -38,6 +38,7 @@ struct pool {
 #define POOL_MAGIC			0x606658fa
 	VTAILQ_ENTRY(pool)		list;
 	VTAILQ_HEAD(,poolsock)		poolsocks;
+	unsigned			nr;
 
 	int				die;
 	pthread_cond_t			herder_cond;
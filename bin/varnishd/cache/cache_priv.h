@@ -56,6 +56,7 @@ void BAN_Shutdown(void);
 void BAN_NewObjCore(struct objcore *oc);
 void BAN_DestroyObj(struct objcore *oc);
 int BAN_CheckObject(struct worker *, struct objcore *, struct req *);
+int BAN_Current(const struct objcore *);
 
 /* cache_busyobj.c */
 void VBO_Init(void);
@@ -65,6 +66,11 @@ void CLI_Init(void);
 void CLI_Run(void);
 void CLI_AddFuncs(struct cli_proto *p);
 
+/* cache_esi_deliver.c */
+void VED_Init(void);
+void VED_Free(struct worker *, struct objcore *);
+int VED_Planned(struct req *);
+
 /* cache_expire.c */
 void EXP_Init(void);
 
@@ -32,6 +32,9 @@
 #include "cache/cache.h"
 #include "cache/cache_filter.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "vct.h"
 
 /*--------------------------------------------------------------------*/
@@ -87,14 +90,148 @@ vrg_range_bytes(struct req *req, enum vdp_action act, void **priv,
 /*--------------------------------------------------------------------*/
 
 static const char *
-vrg_dorange(struct req *req, const char *r)
+vrg_single(struct req *req, ssize_t low, ssize_t high)
 {
-	ssize_t low, high, has_low, has_high, t;
 	struct vrg_priv *vrg_priv;
 
-	if (strncasecmp(r, "bytes=", 6))
-		return ("Not Bytes");
-	r += 6;
+	if (req->resp_len >= 0)
+		http_PrintfHeader(req->resp, "Content-Range: bytes %jd-%jd/%jd",
+		    (intmax_t)low, (intmax_t)high, (intmax_t)req->resp_len);
+	else
+		http_PrintfHeader(req->resp, "Content-Range: bytes %jd-%jd/*",
+		    (intmax_t)low, (intmax_t)high);
+	req->resp_len = (intmax_t)(1 + high - low);
+
+	vrg_priv = WS_Alloc(req->ws, sizeof *vrg_priv);
+	if (vrg_priv == NULL)
+		return ("WS too small");
+
+	XXXAN(vrg_priv);
+	INIT_OBJ(vrg_priv, VRG_PRIV_MAGIC);
+	vrg_priv->range_off = 0;
+	vrg_priv->range_low = low;
+	vrg_priv->range_high = high + 1;
+	VDP_push(req, vrg_range_bytes, vrg_priv, 1, "RNG");
+
+	/*
+	 * If we see the stored bytes as they are, we can have the
+	 * iterator skip to the start of the range.
+	 */
+	if (VTAILQ_FIRST(&req->vdp)->priv == vrg_priv) {
+		req->vdp_off = low;
+		vrg_priv->range_off = low;
+	}
+	http_PutResponse(req->resp, "HTTP/1.1", 206, NULL);
+	return (NULL);
+}
+
+/*--------------------------------------------------------------------
+ * multipart/byteranges (RFC 7233, Appendix A)
+ *
+ * The ranges are sorted and coalesced, so the body is a single pass
+ * over the object, with a part header in front of each range.
+ */
+
+struct vrg_part {
+	ssize_t			low;
+	ssize_t			high;		/* Exclusive */
+	const char		*hdr;
+};
+
+struct vrg_multi {
+	unsigned		magic;
+#define VRG_MULTI_MAGIC		0x4d1f0c39
+	unsigned		nparts;
+	unsigned		cur;
+	struct vrg_part		*parts;
+	const char		*trailer;
+	ssize_t			range_off;
+};
+
+static int __match_proto__(vdp_bytes)
+vrg_multi_bytes(struct req *req, enum vdp_action act, void **priv,
+    const void *ptr, ssize_t len)
+{
+	int retval = 0;
+	ssize_t l;
+	const char *p = ptr;
+	struct vrg_multi *vrm;
+	struct vrg_part *vp;
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	if (act == VDP_INIT)
+		return (0);
+	CAST_OBJ_NOTNULL(vrm, *priv, VRG_MULTI_MAGIC);
+	if (act == VDP_FINI) {
+		if (vrm->cur < vrm->nparts)
+			Req_Fail(req, SC_RANGE_SHORT);
+		*priv = NULL;	/* struct on ws, no need to free */
+		return (0);
+	}
+
+	while (retval == 0 && len > 0 && vrm->cur < vrm->nparts) {
+		vp = &vrm->parts[vrm->cur];
+		l = vp->low - vrm->range_off;
+		if (l > 0) {
+			/* Skip to the start of the part */
+			if (l > len)
+				l = len;
+		} else {
+			if (l == 0)
+				retval = VDP_bytes(req, VDP_NULL,
+				    vp->hdr, strlen(vp->hdr));
+			l = vp->high - vrm->range_off;
+			if (l > len)
+				l = len;
+			if (retval == 0)
+				retval = VDP_bytes(req, VDP_NULL, p, l);
+			if (vrm->range_off + l == vp->high)
+				vrm->cur++;
+		}
+		vrm->range_off += l;
+		p += l;
+		len -= l;
+	}
+	if (retval == 0 && vrm->cur == vrm->nparts && vrm->trailer != NULL) {
+		retval = VDP_bytes(req, VDP_NULL,
+		    vrm->trailer, strlen(vrm->trailer));
+		vrm->trailer = NULL;
+	}
+	if (retval == 0 && act > VDP_NULL)
+		retval = VDP_bytes(req, act, NULL, 0);
+	return (retval || vrm->cur == vrm->nparts ? 1 : 0);
+}
+
+static int
+vrg_part_cmp(const void *a, const void *b)
+{
+	const struct vrg_part *pa = a, *pb = b;
+
+	if (pa->low != pb->low)
+		return (pa->low < pb->low ? -1 : 1);
+	if (pa->high != pb->high)
+		return (pa->high < pb->high ? -1 : 1);
+	return (0);
+}
+
+/*--------------------------------------------------------------------
+ * Parse one byte-range-spec, up to the next ',' or end of string.
+ *
+ * Returns an error, or NULL with *plow set to -1 if the whole object
+ * should be delivered instead.  It is up to the caller to check that
+ * low is inside the object, high is not valid if it is not.
+ */
+
+static const char *
+vrg_spec(const char **pp, ssize_t len, ssize_t *plow, ssize_t *phigh)
+{
+	ssize_t low, high, has_low, has_high, t;
+	const char *r = *pp;
+
+	*plow = -1;
+
+	while (*r == ' ' || *r == '\t')
+		r++;
 
 	/* The low end of range */
 	has_low = low = 0;
@@ -121,24 +258,27 @@ vrg_dorange(struct req *req, const char *r)
 			return ("High number too big");
 	}
 
-	if (*r != '\0')
+	while (*r == ' ' || *r == '\t')
+		r++;
+	if (*r != '\0' && *r != ',')
 		return ("Trailing stuff");
+	*pp = r;
 
 	if (has_high + has_low == 0)
 		return ("Neither high nor low");
 
 	if (!has_low) {
-		if (req->resp_len < 0)
+		if (len < 0)
 			return (NULL);		// Allow 200 response
 		if (high == 0)
 			return ("No low, high is zero");
-		low = req->resp_len - high;
+		low = len - high;
 		if (low < 0)
 			low = 0;
-		high = req->resp_len - 1;
-	} else if (req->resp_len >= 0 && (high >= req->resp_len || !has_high))
-		high = req->resp_len - 1;
-	else if (!has_high || req->resp_len < 0)
+		high = len - 1;
+	} else if (len >= 0 && (high >= len || !has_high))
+		high = len - 1;
+	else if (!has_high || len < 0)
 		return (NULL);			// Allow 200 response
 	/*
 	 * else (bo != NULL) {
@@ -147,34 +287,145 @@ vrg_dorange(struct req *req, const char *r)
 	 * }
 	 */
 
+	*plow = low;
+	*phigh = high;
+	if (len >= 0 && low >= len)
+		return (NULL);			// Caller decides
 	if (high < low)
 		return ("high smaller than low");
+	return (NULL);
+}
 
-	if (req->resp_len >= 0 && low >= req->resp_len)
+/*--------------------------------------------------------------------*/
+
+static const char *
+vrg_multirange(struct req *req, const char *r, unsigned n)
+{
+	struct vrg_multi *vrm;
+	struct vrg_part *vp;
+	const char *err, *ct;
+	char boundary[24];
+	ssize_t low, high;
+	intmax_t len;
+	unsigned u, v;
+
+	if (req->resp_len < 0)
+		return (NULL);			// Allow 200 response
+	if (n > cache_param->http_range_max)
+		return (NULL);			// Allow 200 response
+
+	vrm = WS_Alloc(req->ws, sizeof *vrm);
+	vp = WS_Alloc(req->ws, n * sizeof *vp);
+	if (vrm == NULL || vp == NULL)
+		return ("WS too small");
+	INIT_OBJ(vrm, VRG_MULTI_MAGIC);
+	vrm->parts = vp;
+
+	for (u = 0; ; r++) {
+		err = vrg_spec(&r, req->resp_len, &low, &high);
+		if (err != NULL)
+			return (err);
+		if (low < 0)
+			return (NULL);		// Allow 200 response
+		if (low < req->resp_len) {
+			/* Unsatisfiable ones are left out */
+			assert(u < n);
+			vp[u].low = low;
+			vp[u].high = high + 1;
+			u++;
+		}
+		if (*r == '\0')
+			break;
+		assert(*r == ',');
+	}
+	if (u == 0)
 		return ("low range beyond object");
 
-	if (req->resp_len >= 0)
-		http_PrintfHeader(req->resp, "Content-Range: bytes %jd-%jd/%jd",
-		    (intmax_t)low, (intmax_t)high, (intmax_t)req->resp_len);
-	else
-		http_PrintfHeader(req->resp, "Content-Range: bytes %jd-%jd/*",
-		    (intmax_t)low, (intmax_t)high);
-	req->resp_len = (intmax_t)(1 + high - low);
+	/* Sort and coalesce overlapping and adjacent ranges */
+	qsort(vp, u, sizeof *vp, vrg_part_cmp);
+	for (n = u, u = 0, v = 1; v < n; v++) {
+		if (vp[v].low <= vp[u].high) {
+			if (vp[v].high > vp[u].high)
+				vp[u].high = vp[v].high;
+		} else
+			vp[++u] = vp[v];
+	}
+	vrm->nparts = u + 1;
+	if (vrm->nparts == 1)
+		return (vrg_single(req, vp->low, vp->high - 1));
 
-	vrg_priv = WS_Alloc(req->ws, sizeof *vrg_priv);
-	if (vrg_priv == NULL)
+	bprintf(boundary, "%08x%08lx",
+	    VXID(req->vsl->wid), (unsigned long)random());
+	if (!http_GetHdr(req->resp, H_Content_Type, &ct))
+		ct = NULL;
+
+	len = 0;
+	for (u = 0; u < vrm->nparts; u++) {
+		if (ct != NULL)
+			vp[u].hdr = WS_Printf(req->ws,
+			    "\r\n--%s\r\nContent-Type: %s\r\n"
+			    "Content-Range: bytes %jd-%jd/%jd\r\n\r\n",
+			    boundary, ct, (intmax_t)vp[u].low,
+			    (intmax_t)vp[u].high - 1, (intmax_t)req->resp_len);
+		else
+			vp[u].hdr = WS_Printf(req->ws,
+			    "\r\n--%s\r\n"
+			    "Content-Range: bytes %jd-%jd/%jd\r\n\r\n",
+			    boundary, (intmax_t)vp[u].low,
+			    (intmax_t)vp[u].high - 1, (intmax_t)req->resp_len);
+		if (vp[u].hdr == NULL)
+			return ("WS too small");
+		len += strlen(vp[u].hdr) + (vp[u].high - vp[u].low);
+	}
+	vrm->trailer = WS_Printf(req->ws, "\r\n--%s--\r\n", boundary);
+	if (vrm->trailer == NULL)
 		return ("WS too small");
+	len += strlen(vrm->trailer);
+	http_Unset(req->resp, H_Content_Type);
+	http_PrintfHeader(req->resp,
+	    "Content-Type: multipart/byteranges; boundary=%s", boundary);
+	req->resp_len = len;
 
-	XXXAN(vrg_priv);
-	INIT_OBJ(vrg_priv, VRG_PRIV_MAGIC);
-	vrg_priv->range_off = 0;
-	vrg_priv->range_low = low;
-	vrg_priv->range_high = high + 1;
-	VDP_push(req, vrg_range_bytes, vrg_priv, 1, "RNG");
+	VDP_push(req, vrg_multi_bytes, vrm, 1, "RNG");
+	if (VTAILQ_FIRST(&req->vdp)->priv == vrm) {
+		req->vdp_off = vp->low;
+		vrm->range_off = vp->low;
+	}
 	http_PutResponse(req->resp, "HTTP/1.1", 206, NULL);
 	return (NULL);
 }
 
+/*--------------------------------------------------------------------*/
+
+static const char *
+vrg_dorange(struct req *req, const char *r)
+{
+	ssize_t low, high;
+	const char *err, *p;
+	unsigned n;
+
+	if (strncasecmp(r, "bytes=", 6))
+		return ("Not Bytes");
+	r += 6;
+
+	for (n = 1, p = r; *p != '\0'; p++)
+		if (*p == ',')
+			n++;
+	if (n > 1)
+		return (vrg_multirange(req, r, n));
+
+	err = vrg_spec(&r, req->resp_len, &low, &high);
+	if (err != NULL)
+		return (err);
+	if (low < 0)
+		return (NULL);			// Allow 200 response
+
+	if (req->resp_len >= 0 && low >= req->resp_len)
+		return ("low range beyond object");
+
+	return (vrg_single(req, low, high));
+}
+
 void
 VRG_dorange(struct req *req, const char *r)
 {
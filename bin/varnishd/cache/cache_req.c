@@ -200,6 +200,7 @@ Req_Cleanup(struct sess *sp, struct worker *wrk, struct req *req)
 		VSL_End(req->vsl);
 	}
 	req->req_bodybytes = 0;
+	req->req_body_spool = 0;
 
 	if (!isnan(req->t_prev) && req->t_prev > 0.)
 		sp->t_idle = req->t_prev;
@@ -213,6 +214,7 @@ Req_Cleanup(struct sess *sp, struct worker *wrk, struct req *req)
 
 	req->hash_always_miss = 0;
 	req->hash_ignore_busy = 0;
+	req->hash_wait_busy = 0;
 	req->is_hit = 0;
 
 	WS_Reset(req->ws, 0);
@@ -42,6 +42,12 @@
 /*----------------------------------------------------------------------
  * Pull the req.body in via/into a objcore
  *
+ * Without a func, the req.body is cached, and it is an error if it is
+ * bigger than maxsize.  With a func and a maxsize, the req.body is also
+ * spooled into the objcore on its way past, until it gets bigger than
+ * maxsize.  Should func fail before that, the rest of the req.body is
+ * still spooled, so that it can be sent again.
+ *
  * This can be called only once per request
  *
  */
@@ -54,6 +60,7 @@ vrb_pull(struct req *req, ssize_t maxsize, objiterate_f *func, void *priv)
 	uint8_t *ptr;
 	enum vfp_status vfps = VFP_ERROR;
 	const struct stevedore *stv;
+	int spool;
 
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
 
@@ -91,9 +98,12 @@ vrb_pull(struct req *req, ssize_t maxsize, objiterate_f *func, void *priv)
 	}
 	if (yet < 0)
 		yet = 0;
+	spool = func == NULL ||
+	    (maxsize >= 0 && req->htc->content_length <= maxsize);
 	do {
 		AZ(vfc->failed);
-		if (maxsize >= 0 && req->req_bodybytes > maxsize) {
+		if (func == NULL && maxsize >= 0 &&
+		    req->req_bodybytes > maxsize) {
 			(void)VFP_Error(vfc, "Request body too big to cache");
 			break;
 		}
@@ -109,19 +119,28 @@ vrb_pull(struct req *req, ssize_t maxsize, objiterate_f *func, void *priv)
 			req->acct.req_bodybytes += l;
 			if (yet >= l)
 				yet -= l;
-			if (func != NULL) {
+			if (func != NULL && r == 0)
 				r = func(priv, 1, ptr, l);
-				if (r)
-					break;
-			} else {
-				ObjExtend(req->wrk, req->body_oc, l);
+			if (spool && func != NULL &&
+			    req->req_bodybytes > maxsize) {
+				VSLb(req->vsl, SLT_Debug,
+				    "Request body too big to spool");
+				spool = 0;
 			}
+			/*
+			 * If func failed, we keep spooling the rest for the
+			 * retry, but there is no point without a copy.
+			 */
+			if (r && !spool)
+				break;
+			if (spool)
+				ObjExtend(req->wrk, req->body_oc, l);
 		}
 
 	} while (vfps == VFP_OK);
 	VFP_Close(vfc);
 	VSLb_ts_req(req, "ReqBody", VTIM_real());
-	if (func != NULL) {
+	if (func != NULL && (!spool || vfps != VFP_END)) {
 		HSH_DerefBoc(req->wrk, req->body_oc);
 		AZ(HSH_DerefObjCore(req->wrk, &req->body_oc, 0));
 		if (vfps != VFP_END) {
@@ -143,6 +162,9 @@ vrb_pull(struct req *req, ssize_t maxsize, objiterate_f *func, void *priv)
 	}
 
 	assert(req->req_bodybytes >= 0);
+	if (func != NULL)
+		VSC_C_main->req_body_spooled++;
+
 	if (req->req_bodybytes != req->htc->content_length) {
 		/* We must update also the "pristine" req.* copy */
 		http_Unset(req->http0, H_Content_Length);
@@ -157,7 +179,7 @@ vrb_pull(struct req *req, ssize_t maxsize, objiterate_f *func, void *priv)
 	}
 
 	req->req_body_status = REQ_BODY_CACHED;
-	return (req->req_bodybytes);
+	return (func != NULL ? r : req->req_bodybytes);
 }
 
 /*----------------------------------------------------------------------
@@ -212,7 +234,8 @@ VRB_Iterate(struct req *req, objiterate_f *func, void *priv)
 		    "Multiple attempts to access non-cached req.body");
 		return (i);
 	}
-	return (vrb_pull(req, -1, func, priv));
+	return (vrb_pull(req,
+	    req->req_body_spool > 0 ? req->req_body_spool : -1, func, priv));
 }
 
 /*----------------------------------------------------------------------
@@ -242,6 +265,7 @@ VRB_Ignore(struct req *req)
 
 	if (req->doclose)
 		return (0);
+	req->req_body_spool = 0;
 	if (req->req_body_status == REQ_BODY_WITH_LEN ||
 	    req->req_body_status == REQ_BODY_WITHOUT_LEN)
 		(void)VRB_Iterate(req, httpq_req_body_discard, NULL);
@@ -306,3 +330,43 @@ VRB_Cache(struct req *req, ssize_t maxsize)
 
 	return (vrb_pull(req, maxsize, NULL, NULL));
 }
+
+/*----------------------------------------------------------------------
+ * Spool the req.body into storage as it is sent to the backend, if it
+ * is no bigger than the given size, so that it can be sent again on
+ * retries and restarts, the way a cached req.body is.
+ *
+ * Unlike VRB_Cache(), this does not hold up the first fetch until the
+ * entire req.body has been received.
+ */
+
+int
+VRB_Spool(struct req *req, ssize_t maxsize)
+{
+
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	assert(maxsize >= 0);
+
+	if (req->restarts > 0 && req->req_body_status != REQ_BODY_CACHED)
+		return (-1);
+
+	assert (req->req_step == R_STP_RECV);
+	switch (req->req_body_status) {
+	case REQ_BODY_CACHED:
+	case REQ_BODY_NONE:
+		return (0);
+	case REQ_BODY_FAIL:
+		return (-1);
+	case REQ_BODY_WITHOUT_LEN:
+	case REQ_BODY_WITH_LEN:
+		break;
+	default:
+		WRONG("Wrong req_body_status in VRB_Spool()");
+	}
+
+	if (req->htc->content_length > maxsize)
+		return (-1);
+
+	req->req_body_spool = maxsize;
+	return (0);
+}
@@ -38,6 +38,8 @@
 
 #include "config.h"
 
+#include <errno.h>
+
 #include "cache.h"
 #include "cache_director.h"
 #include "cache_filter.h"
@@ -338,6 +340,7 @@ cnt_transmit(struct worker *wrk, struct req *req)
 	uint16_t status;
 	int sendbody;
 	intmax_t clval;
+	ssize_t brlen;
 
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
@@ -367,12 +370,24 @@ cnt_transmit(struct worker *wrk, struct req *req)
 	} else
 		sendbody = 1;
 
+	if (sendbody >= 0 && boc == NULL && req->esi_level == 0 &&
+	    status == 200 && req->accept_br &&
+	    ObjGetAttr(wrk, req->objcore, OA_BRBODY, &brlen) != NULL) {
+		/* Deliver the brotli copy made at fetch time */
+		req->res_mode |= RES_BROTLI;
+		req->resp_len = brlen;
+		http_Unset(req->resp, H_Content_Encoding);
+		http_SetHeader(req->resp, "Content-Encoding: br");
+		RFC2616_Weaken_Etag(req->resp);
+	}
+
 	if (sendbody >= 0) {
 		if (!req->disable_esi && req->resp_len != 0 &&
 		    ObjHasAttr(wrk, req->objcore, OA_ESIDATA))
 			VDP_push(req, VDP_ESI, NULL, 0, "ESI");
 
 		if (cache_param->http_gzip_support &&
+		    !(req->res_mode & RES_BROTLI) &&
 		    ObjCheckFlag(req->wrk, req->objcore, OF_GZIPED) &&
 		    !RFC2616_Req_Gzip(req->http))
 			VDP_push(req, VDP_gunzip, NULL, 1, "GUZ");
@@ -450,10 +465,38 @@ cnt_fetch(struct worker *wrk, struct req *req)
  * this state if we get suspended on a busy objhdr.
  */
 
+/*
+ * Wait for another request's revalidation of the object to get its
+ * response headers, for at most collapse_revalidation_timeout.
+ */
+
+static int
+cnt_wait_revalidation(struct worker *wrk, struct objcore *oc)
+{
+	struct boc *boc;
+	double when;
+	int i = 0;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(oc, OBJCORE_MAGIC);
+
+	boc = HSH_RefBoc(oc);
+	if (boc == NULL)
+		return (1);
+	when = VTIM_real() + cache_param->collapse_revalidation_timeout;
+	Lck_Lock(&boc->mtx);
+	while (boc->state < BOS_STREAM && i != ETIMEDOUT)
+		i = Lck_CondWait(&boc->cond, &boc->mtx, when);
+	i = boc->state >= BOS_STREAM;
+	Lck_Unlock(&boc->mtx);
+	HSH_DerefBoc(wrk, oc);
+	return (i);
+}
+
 static enum req_fsm_nxt
 cnt_lookup(struct worker *wrk, struct req *req)
 {
-	struct objcore *oc, *busy;
+	struct objcore *oc, *busy, *reval;
 	enum lookup_e lr;
 	int had_objhead = 0;
 
@@ -466,9 +509,10 @@ cnt_lookup(struct worker *wrk, struct req *req)
 	VRY_Prep(req);
 
 	AZ(req->objcore);
-	if (req->hash_objhead)
+	if (req->hash_objhead != NULL || req->hash_oc != NULL)
 		had_objhead = 1;
-	lr = HSH_Lookup(req, &oc, &busy, req->hash_always_miss ? 1 : 0);
+	lr = HSH_Lookup(req, &oc, &busy, &reval,
+	    req->hash_always_miss ? 1 : 0);
 	if (lr == HSH_BUSY) {
 		/*
 		 * We lost the session to a busy object, disembark the
@@ -511,6 +555,9 @@ cnt_lookup(struct worker *wrk, struct req *req)
 
 	VCL_hit_method(req->vcl, wrk, req, NULL, NULL);
 
+	if (reval != NULL && wrk->handling != VCL_RET_MISS)
+		(void)HSH_DerefObjCore(wrk, &reval, 0);
+
 	switch (wrk->handling) {
 	case VCL_RET_DELIVER:
 		if (busy != NULL) {
@@ -520,7 +567,8 @@ cnt_lookup(struct worker *wrk, struct req *req)
 		} else {
 			(void)VRB_Ignore(req);// XXX: handle err
 		}
-		wrk->stats->cache_hit++;
+		if (!req->esi_prefetch)
+			wrk->stats->cache_hit++;
 		req->is_hit = 1;
 		req->req_step = R_STP_DELIVER;
 		return (REQ_FSM_MORE);
@@ -529,6 +577,28 @@ cnt_lookup(struct worker *wrk, struct req *req)
 			req->objcore = busy;
 			req->stale_oc = oc;
 			req->req_step = R_STP_MISS;
+		} else if (reval != NULL &&
+		    cache_param->collapse_revalidation &&
+		    !req->hash_wait_busy && !req->esi_prefetch) {
+			/*
+			 * Another request is fetching this object, so
+			 * rather than sending our own request to the
+			 * backend, wait for it and look it up again.
+			 * If it takes too long, make do with what we
+			 * have.
+			 */
+			wrk->stats->busy_revalidate++;
+			req->hash_wait_busy = 1;
+			if (cnt_wait_revalidation(wrk, reval)) {
+				(void)HSH_DerefObjCore(wrk, &req->objcore,
+				    HSH_RUSH_POLICY);
+				req->req_step = R_STP_LOOKUP;
+			} else {
+				wrk->stats->busy_revalidate_stale++;
+				(void)VRB_Ignore(req);
+				req->is_hit = 1;
+				req->req_step = R_STP_DELIVER;
+			}
 		} else {
 			(void)HSH_DerefObjCore(wrk, &req->objcore,
 			    HSH_RUSH_POLICY);
@@ -541,6 +611,8 @@ cnt_lookup(struct worker *wrk, struct req *req)
 			    "  Doing pass.");
 			req->req_step = R_STP_PASS;
 		}
+		if (reval != NULL)
+			(void)HSH_DerefObjCore(wrk, &reval, 0);
 		return (REQ_FSM_MORE);
 	case VCL_RET_RESTART:
 		req->req_step = R_STP_RESTART;
@@ -552,7 +624,8 @@ cnt_lookup(struct worker *wrk, struct req *req)
 		req->req_step = R_STP_SYNTH;
 		break;
 	case VCL_RET_PASS:
-		wrk->stats->cache_hit++;
+		if (!req->esi_prefetch)
+			wrk->stats->cache_hit++;
 		req->is_hit = 1;
 		req->req_step = R_STP_PASS;
 		break;
@@ -587,8 +660,16 @@ cnt_miss(struct worker *wrk, struct req *req)
 	VCL_miss_method(req->vcl, wrk, req, NULL, NULL);
 	switch (wrk->handling) {
 	case VCL_RET_FETCH:
-		wrk->stats->cache_miss++;
-		VBF_Fetch(wrk, req, req->objcore, req->stale_oc, VBF_NORMAL);
+		if (req->esi_prefetch) {
+			/* Nobody is waiting for the response here */
+			VBF_Fetch(wrk, req, req->objcore, req->stale_oc,
+			    VBF_BACKGROUND);
+			req->objcore = NULL;
+		} else {
+			wrk->stats->cache_miss++;
+			VBF_Fetch(wrk, req, req->objcore, req->stale_oc,
+			    VBF_NORMAL);
+		}
 		if (req->stale_oc != NULL)
 			(void)HSH_DerefObjCore(wrk, &req->stale_oc, 0);
 		req->req_step = R_STP_FETCH;
@@ -794,6 +875,7 @@ cnt_recv(struct worker *wrk, struct req *req)
 	req->disable_esi = 0;
 	req->hash_always_miss = 0;
 	req->hash_ignore_busy = 0;
+	req->hash_wait_busy = 0;
 	req->client_identity = NULL;
 	req->storage = NULL;
 
@@ -829,6 +911,9 @@ cnt_recv(struct worker *wrk, struct req *req)
 
 	recv_handling = wrk->handling;
 
+	/* Brotli copies are not variants, remember if we can send one */
+	req->accept_br = RFC2616_Req_Br(req->http);
+
 	/* We wash the A-E header here for the sake of VRY */
 	if (cache_param->http_gzip_support &&
 	     (recv_handling != VCL_RET_PIPE) &&
@@ -913,7 +998,7 @@ cnt_purge(struct worker *wrk, struct req *req)
 	VRY_Prep(req);
 
 	AZ(req->objcore);
-	lr = HSH_Lookup(req, &oc, &boc, 1);
+	lr = HSH_Lookup(req, &oc, &boc, NULL, 1);
 	assert (lr == HSH_MISS);
 	AZ(oc);
 	CHECK_OBJ_NOTNULL(boc, OBJCORE_MAGIC);
@@ -940,6 +1025,133 @@ cnt_purge(struct worker *wrk, struct req *req)
 	return (REQ_FSM_MORE);
 }
 
+/*--------------------------------------------------------------------
+ * A request started on the transport's own thread must not block it.
+ * Hand it over to a worker thread before entering a step which may
+ * wait for a backend or for a fetch in progress.  If no worker thread
+ * can be had, we carry on here.
+ */
+
+static int
+cnt_offload(struct worker *wrk, struct req *req)
+{
+	struct boc *boc;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	AN(req->transport_inline);
+
+	switch (req->req_step) {
+	case R_STP_MISS:
+	case R_STP_PASS:
+	case R_STP_PIPE:
+		break;
+	case R_STP_DELIVER:
+		CHECK_OBJ_NOTNULL(req->objcore, OBJCORE_MAGIC);
+		boc = HSH_RefBoc(req->objcore);
+		if (boc != NULL) {
+			HSH_DerefBoc(wrk, req->objcore);
+			break;
+		}
+		if (!req->disable_esi &&
+		    ObjHasAttr(wrk, req->objcore, OA_ESIDATA))
+			break;
+		return (0);
+	default:
+		return (0);
+	}
+
+	req->transport_inline = 0;
+	if (SES_Reschedule_Req(req))
+		return (0);
+	wrk->stats->req_offload++;
+	return (1);
+}
+
+/*--------------------------------------------------------------------
+ * Requests which may only be answered from cache (ie: H/2 server push)
+ * are abandoned without a response when they would go to the backend.
+ * It is up to the transport to tell the client.
+ */
+
+static int
+cnt_hit_only(struct worker *wrk, struct req *req)
+{
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	AN(req->hit_only);
+
+	switch (req->req_step) {
+	case R_STP_MISS:
+		VRY_Clear(req);
+		if (req->stale_oc != NULL)
+			(void)HSH_DerefObjCore(wrk, &req->stale_oc, 0);
+		AZ(HSH_DerefObjCore(wrk, &req->objcore, 1));
+		break;
+	case R_STP_PASS:
+	case R_STP_PIPE:
+		AZ(req->objcore);
+		break;
+	default:
+		return (0);
+	}
+	VSLb(req->vsl, SLT_Debug, "Not a hit, abandoned");
+	return (1);
+}
+
+/*--------------------------------------------------------------------
+ * ESI includes which may be delivered from the fragment they found
+ * last time stop short of the lookup if vcl_hash{} agrees.
+ */
+
+static int
+cnt_esi_plan(struct worker *wrk, struct req *req)
+{
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	AN(req->esi_plan);
+
+	if (req->req_step != R_STP_LOOKUP || !VED_Planned(req))
+		return (0);
+	AZ(req->objcore);
+	return (1);
+}
+
+/*--------------------------------------------------------------------
+ * ESI includes looked up ahead of their turn are done once they have
+ * found their object in the cache or started fetching it.  Whatever
+ * cannot be shared with the include proper when its turn comes, we
+ * leave to it.
+ */
+
+static int
+cnt_prefetch(struct worker *wrk, struct req *req)
+{
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
+	AN(req->esi_prefetch);
+
+	switch (req->req_step) {
+	case R_STP_DELIVER:
+		CHECK_OBJ_NOTNULL(req->objcore, OBJCORE_MAGIC);
+		(void)HSH_DerefObjCore(wrk, &req->objcore, HSH_RUSH_POLICY);
+		break;
+	case R_STP_FETCH:
+	case R_STP_PASS:
+	case R_STP_PIPE:
+	case R_STP_PURGE:
+	case R_STP_SYNTH:
+		AZ(req->objcore);
+		break;
+	default:
+		return (0);
+	}
+	return (1);
+}
+
 /*--------------------------------------------------------------------
  * Central state engine dispatcher.
  *
@@ -972,7 +1184,11 @@ CNT_Request(struct worker *wrk, struct req *req)
 	assert(
 	    req->req_step == R_STP_LOOKUP ||
 	    req->req_step == R_STP_TRANSPORT ||
-	    req->req_step == R_STP_RECV);
+	    req->req_step == R_STP_RECV ||
+	    req->req_step == R_STP_MISS ||
+	    req->req_step == R_STP_PASS ||
+	    req->req_step == R_STP_PIPE ||
+	    req->req_step == R_STP_DELIVER);
 
 	AN(req->vsl->wid & VSL_CLIENTMARKER);
 
@@ -995,6 +1211,23 @@ CNT_Request(struct worker *wrk, struct req *req)
 		WS_Assert(wrk->aws);
 		AZ(WS_Snapshot(wrk->aws));
 
+		if (req->transport_inline && cnt_offload(wrk, req)) {
+			nxt = REQ_FSM_DISEMBARK;
+			break;
+		}
+		if (req->hit_only && cnt_hit_only(wrk, req)) {
+			nxt = REQ_FSM_DONE;
+			break;
+		}
+		if (req->esi_prefetch && cnt_prefetch(wrk, req)) {
+			nxt = REQ_FSM_DONE;
+			break;
+		}
+		if (req->esi_plan && cnt_esi_plan(wrk, req)) {
+			nxt = REQ_FSM_DONE;
+			break;
+		}
+
 		switch (req->req_step) {
 #define REQ_STEP(l,u,arg) \
 		    case R_STP_##u: \
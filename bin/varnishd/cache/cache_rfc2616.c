@@ -232,6 +232,17 @@ RFC2616_Req_Gzip(const struct http *hp)
 	return (0);
 }
 
+/*--------------------------------------------------------------------
+ * Find out if the request can receive a brotli'ed response
+ */
+
+unsigned
+RFC2616_Req_Br(const struct http *hp)
+{
+
+	return (http_GetHdrQ(hp, H_Accept_Encoding, "br") > 0.);
+}
+
 /*--------------------------------------------------------------------*/
 
 static inline int
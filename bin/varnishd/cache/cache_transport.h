@@ -67,6 +67,7 @@ struct transport {
 };
 
 extern struct transport PROXY_transport;
+extern struct transport KTLS_transport;
 extern struct transport HTTP1_transport;
 extern struct transport H2_transport;
 htc_complete_f H2_prism_complete;
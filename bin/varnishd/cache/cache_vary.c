@@ -215,6 +215,26 @@ vry_cmp(const uint8_t *v1, const uint8_t *v2)
 	return (retval);
 }
 
+/*
+ * Would a Vary string match any request?  That is, does it only vary on
+ * Accept-Encoding, which vry_cmp() ignores?
+ */
+
+int
+VRY_MatchAll(const uint8_t *vary)
+{
+
+	AN(vary);
+	if (!cache_param->http_gzip_support)
+		return (0);
+	while (vary[2]) {
+		if (strcasecmp(H_Accept_Encoding, (const char*)vary + 2))
+			return (0);
+		vary += VRY_Len(vary);
+	}
+	return (1);
+}
+
 /**********************************************************************
  * Prepare predictive vary string
  *
@@ -225,7 +245,7 @@ vry_cmp(const uint8_t *v1, const uint8_t *v2)
 void
 VRY_Prep(struct req *req)
 {
-	if (req->hash_objhead == NULL) {
+	if (req->hash_objhead == NULL && req->hash_oc == NULL) {
 		/* Not a waiting list return */
 		AZ(req->vary_b);
 		AZ(req->vary_l);
@@ -530,6 +530,20 @@ VRT_CacheReqBody(VRT_CTX, VCL_BYTES maxsize)
 	return (VRB_Cache(ctx->req, maxsize));
 }
 
+VCL_BOOL
+VRT_SpoolReqBody(VRT_CTX, VCL_BYTES maxsize)
+{
+
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(ctx->req, REQ_MAGIC);
+	if (ctx->method != VCL_MET_RECV) {
+		VSLb(ctx->vsl, SLT_VCL_Error,
+		    "req.body can only be spooled in vcl_recv{}");
+		return (0);
+	}
+	return (VRB_Spool(ctx->req, maxsize) == 0);
+}
+
 /*--------------------------------------------------------------------
  * purges
  */
@@ -40,6 +40,7 @@ struct listen_arg {
 	const char			*name;
 	VTAILQ_HEAD(,listen_sock)	socks;
 	const struct transport		*transport;
+	const char			*helper;	/* KTLS */
 };
 
 struct listen_sock {
@@ -63,7 +63,7 @@ enum lookup_e {
 struct ban;
 void HSH_Cleanup(struct worker *w);
 enum lookup_e HSH_Lookup(struct req *, struct objcore **, struct objcore **,
-    int always_insert);
+    struct objcore **, int always_insert);
 void HSH_Ref(struct objcore *o);
 void HSH_Init(const struct hash_slinger *slinger);
 void HSH_AddString(struct req *, void *ctx, const char *str);
@@ -78,6 +78,7 @@ struct objcore *HSH_Private(struct worker *wrk);
 void HSH_Abandon(struct objcore *oc);
 int HSH_Snipe(const struct worker *, struct objcore *);
 void HSH_Kill(struct objcore *);
+int HSH_Current(struct objcore *, double now);
 
 #ifdef VARNISH_CACHE_CHILD
 
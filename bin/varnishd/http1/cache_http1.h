@@ -58,4 +58,8 @@ void V1L_Reserve(struct worker *, struct ws *, int *fd, struct vsl_log *,
     double t0);
 unsigned V1L_Flush(const struct worker *w);
 unsigned V1L_FlushRelease(struct worker *w);
+unsigned V1L_Writes(const struct worker *w);
 size_t V1L_Write(const struct worker *w, const void *ptr, ssize_t len);
+#ifdef HAVE_SENDFILE
+size_t V1L_Sendfile(const struct worker *w, int fd, off_t off, ssize_t len);
+#endif
@@ -58,6 +58,54 @@ v1d_bytes(struct req *req, enum vdp_action act, void **priv,
 	return (0);
 }
 
+/*--------------------------------------------------------------------
+ * Zero-copy delivery: If nothing but v1d_bytes() is on the VDP stack
+ * the body can go straight from the storage file to the socket.
+ * Private objects are left alone, their storage is recycled as soon
+ * as we are done, while the kernel may still hold on to the pages.
+ *
+ * Returns 1 if the body must be delivered through the VDP stack.
+ */
+
+#ifdef HAVE_SENDFILE
+static int __match_proto__(objsendfile_f)
+v1d_sendfile(void *priv, int fd, off_t off, ssize_t len)
+{
+	struct req *req;
+	ssize_t wl;
+
+	CAST_OBJ_NOTNULL(req, priv, REQ_MAGIC);
+	wl = V1L_Sendfile(req->wrk, fd, off, len);
+	req->acct.resp_bodybytes += wl;
+	req->wrk->stats->s_resp_sendfile += wl;
+	if (len != wl)
+		return (-1);
+	return (0);
+}
+#endif
+
+static int
+v1d_trysendfile(struct req *req, const struct boc *boc)
+{
+#ifdef HAVE_SENDFILE
+	struct vdp_entry *vdp;
+
+	if (boc != NULL || req->res_mode & (RES_CHUNKED | RES_BROTLI) ||
+	    req->objcore->flags & OC_F_PRIVATE ||
+	    req->resp_len < (intmax_t)cache_param->sendfile_threshold)
+		return (1);
+	vdp = VTAILQ_FIRST(&req->vdp);
+	CHECK_OBJ_NOTNULL(vdp, VDP_ENTRY_MAGIC);
+	if (vdp->func != v1d_bytes)
+		return (1);
+	return (ObjSendfile(req->wrk, req->objcore, req, v1d_sendfile));
+#else
+	(void)req;
+	(void)boc;
+	return (1);
+#endif
+}
+
 static void
 v1d_error(struct req *req, const char *msg)
 {
@@ -126,13 +174,19 @@ V1D_Deliver(struct req *req, struct boc *boc, int sendbody)
 		(void)V1L_Flush(req->wrk);
 
 	if (sendbody && req->resp_len != 0) {
-		if (req->res_mode & RES_CHUNKED)
-			V1L_Chunked(req->wrk);
-		err = VDP_DeliverObj(req);
+		err = v1d_trysendfile(req, boc);
+		if (err > 0) {
+			if (req->res_mode & RES_CHUNKED)
+				V1L_Chunked(req->wrk);
+			err = VDP_DeliverObj(req);
+		}
 		if (!err && (req->res_mode & RES_CHUNKED))
 			V1L_EndChunk(req->wrk);
 	}
 
+	(void)V1L_Flush(req->wrk);
+	VSLb(req->vsl, SLT_RespWrites, "%u", V1L_Writes(req->wrk));
+
 	if ((V1L_FlushRelease(req->wrk) || err) && req->sp->fd >= 0)
 		Req_Fail(req, SC_REM_CLOSE);
 	AZ(req->wrk->v1l);
@@ -67,7 +67,8 @@ vbf_iter_req_body(void *priv, int flush, const void *ptr, ssize_t l)
  *
  * Return value:
  *	 0 success
- *	 1 failure
+ *	 1 failure, but the spooled req.body can be sent again
+ *	-1 failure
  */
 
 int
@@ -95,6 +96,13 @@ V1F_SendReq(struct worker *wrk, struct busyobj *bo, uint64_t *ctr,
 	    bo->req->req_body_status == REQ_BODY_WITHOUT_LEN) {
 		http_PrintfHeader(hp, "Transfer-Encoding: chunked");
 		do_chunked = 1;
+	} else if (bo->req != NULL &&
+	    bo->req->req_body_status == REQ_BODY_CACHED &&
+	    http_GetHdr(hp, H_Transfer_Encoding, NULL)) {
+		/* A spooled req.body we sent chunked before a retry */
+		http_Unset(hp, H_Transfer_Encoding);
+		http_PrintfHeader(hp, "Content-Length: %ju",
+		    (uintmax_t)bo->req->req_bodybytes);
 	}
 
 	VTCP_hisname(*htc->rfd, abuf, sizeof abuf, pbuf, sizeof pbuf);
@@ -130,6 +138,10 @@ V1F_SendReq(struct worker *wrk, struct busyobj *bo, uint64_t *ctr,
 		    errno, strerror(errno));
 		VSLb_ts_busyobj(bo, "Bereq", W_TIM_real(wrk));
 		htc->doclose = SC_TX_ERROR;
+		if (bo->req != NULL &&
+		    bo->req->req_body_status == REQ_BODY_CACHED &&
+		    bo->req->req_body_spool > 0)
+			return (1);
 		return (-1);
 	}
 	VSLb_ts_busyobj(bo, "Bereq", W_TIM_real(wrk));
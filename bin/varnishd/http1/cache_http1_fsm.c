@@ -195,6 +195,10 @@ http1_reembark(struct worker *wrk, struct req *req)
 	/* Couldn't schedule, ditch */
 	wrk->stats->busy_wakeup--;
 	wrk->stats->busy_killed++;
+	if (req->hash_oc != NULL)
+		(void)HSH_DerefObjCore(wrk, &req->hash_oc, 0);
+	if (req->hash_objhead != NULL)
+		(void)HSH_DerefObjHead(wrk, &req->hash_objhead);
 	AN (req->vcl);
 	VCL_Rel(&req->vcl);
 	Req_AcctLogCharge(wrk->stats, req);
@@ -34,12 +34,18 @@
 
 #include "config.h"
 
+#include <sys/types.h>
+#include <sys/socket.h>
 #include <sys/uio.h>
 #include "cache/cache.h"
 
 #include <errno.h>
 #include <stdio.h>
 
+#if defined(HAVE_SENDFILE) && defined(__linux__)
+#  include <sys/sendfile.h>
+#endif
+
 #include "cache_http1.h"
 #include "vtim.h"
 
@@ -50,6 +56,7 @@ struct v1l {
 #define V1L_MAGIC		0x2f2142e5
 	int			*wfd;
 	unsigned		werr;	/* valid after V1L_Flush() */
+	unsigned		nwrite;	/* write system calls */
 	struct iovec		*iov;
 	unsigned		siov;
 	unsigned		niov;
@@ -149,15 +156,40 @@ v1l_prune(struct v1l *v1l, ssize_t bytes)
 	AZ(v1l->liov);
 }
 
-unsigned
-V1L_Flush(const struct worker *wrk)
+/*--------------------------------------------------------------------
+ * When we flush because we ran out of iovecs, or know that more output
+ * follows right away, MSG_MORE tells the kernel to hold on to a partial
+ * segment rather than send it as a small packet.  Explicit flushes may
+ * be the last output for a while, so they always push.
+ */
+
+static ssize_t
+v1l_writev(struct v1l *v1l, int more)
+{
+#ifdef MSG_MORE
+	struct msghdr msg;
+#endif
+
+	v1l->nwrite++;
+#ifdef MSG_MORE
+	if (more) {
+		memset(&msg, 0, sizeof msg);
+		msg.msg_iov = v1l->iov;
+		msg.msg_iovlen = v1l->niov;
+		return (sendmsg(*v1l->wfd, &msg, MSG_MORE));
+	}
+#else
+	(void)more;
+#endif
+	return (writev(*v1l->wfd, v1l->iov, v1l->niov));
+}
+
+static unsigned
+v1l_flush(struct v1l *v1l, int more)
 {
 	ssize_t i;
-	struct v1l *v1l;
 	char cbuf[32];
 
-	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
-	v1l = wrk->v1l;
 	CHECK_OBJ_NOTNULL(v1l, V1L_MAGIC);
 	AN(v1l->wfd);
 
@@ -181,7 +213,7 @@ V1L_Flush(const struct worker *wrk)
 			v1l->iov[v1l->ciov].iov_len = 0;
 		}
 
-		i = writev(*v1l->wfd, v1l->iov, v1l->niov);
+		i = v1l_writev(v1l, more);
 		if (i > 0)
 			v1l->cnt += i;
 		while (i != v1l->liov && i > 0) {
@@ -207,7 +239,7 @@ V1L_Flush(const struct worker *wrk)
 			    i, v1l->liov);
 
 			v1l_prune(v1l, i);
-			i = writev(*v1l->wfd, v1l->iov, v1l->niov);
+			i = v1l_writev(v1l, more);
 			if (i > 0)
 				v1l->cnt += i;
 		}
@@ -226,6 +258,25 @@ V1L_Flush(const struct worker *wrk)
 	return (v1l->werr);
 }
 
+unsigned
+V1L_Flush(const struct worker *wrk)
+{
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	return (v1l_flush(wrk->v1l, 0));
+}
+
+/* The number of write system calls made so far */
+
+unsigned
+V1L_Writes(const struct worker *wrk)
+{
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(wrk->v1l, V1L_MAGIC);
+	return (wrk->v1l->nwrite);
+}
+
 size_t
 V1L_Write(const struct worker *wrk, const void *ptr, ssize_t len)
 {
@@ -246,10 +297,77 @@ V1L_Write(const struct worker *wrk, const void *ptr, ssize_t len)
 	v1l->niov++;
 	v1l->cliov += len;
 	if (v1l->niov >= v1l->siov)
-		(void)V1L_Flush(wrk);
+		(void)v1l_flush(v1l, 1);
 	return (len);
 }
 
+/*--------------------------------------------------------------------
+ * Send len bytes from fd at off straight to the socket with sendfile(2)
+ * after flushing whatever is queued.  Chunked encoding is not handled.
+ */
+
+#ifdef HAVE_SENDFILE
+static ssize_t
+v1l_sendfile(int sfd, int fd, off_t off, ssize_t len)
+{
+#if defined(__linux__)
+	return (sendfile(sfd, fd, &off, len));
+#else
+	off_t sent = 0;
+
+	if (sendfile(fd, sfd, off, len, NULL, &sent, 0) && sent == 0)
+		return (-1);
+	return (sent);
+#endif
+}
+
+size_t
+V1L_Sendfile(const struct worker *wrk, int fd, off_t off, ssize_t len)
+{
+	struct v1l *v1l;
+	ssize_t i, l = 0;
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	v1l = wrk->v1l;
+	CHECK_OBJ_NOTNULL(v1l, V1L_MAGIC);
+	AN(v1l->wfd);
+	assert(fd >= 0);
+	assert(len > 0);
+	assert(v1l->ciov == v1l->siov);
+
+	if (v1l_flush(v1l, 1) || *v1l->wfd < 0)
+		return (0);
+
+	while (1) {
+		v1l->nwrite++;
+		i = v1l_sendfile(*v1l->wfd, fd, off + l, len - l);
+		if (i <= 0) {
+			v1l->werr++;
+			VSLb(v1l->vsl, SLT_Debug,
+			    "Sendfile error, retval = %zd, len = %zd, errno = %s",
+			    i, len - l, strerror(errno));
+			break;
+		}
+		v1l->cnt += i;
+		l += i;
+		if (l == len)
+			break;
+
+		if (VTIM_real() - v1l->t0 > cache_param->send_timeout) {
+			VSLb(v1l->vsl, SLT_Debug,
+			    "Hit total send timeout, "
+			    "wrote = %zd/%zd; not retrying", l, len);
+			v1l->werr++;
+			break;
+		}
+
+		VSLb(v1l->vsl, SLT_Debug,
+		    "Hit idle send timeout, wrote = %zd/%zd; retrying", l, len);
+	}
+	return (l);
+}
+#endif
+
 void
 V1L_Chunked(const struct worker *wrk)
 {
@@ -266,7 +384,7 @@ V1L_Chunked(const struct worker *wrk)
 	 * a chunk tail, we might as well flush right away.
 	 */
 	if (v1l->niov + 3 >= v1l->siov)
-		(void)V1L_Flush(wrk);
+		(void)v1l_flush(v1l, 1);
 	v1l->siov--;
 	v1l->ciov = v1l->niov++;
 	v1l->cliov = 0;
@@ -291,7 +409,7 @@ V1L_EndChunk(const struct worker *wrk)
 	CHECK_OBJ_NOTNULL(v1l, V1L_MAGIC);
 
 	assert(v1l->ciov < v1l->siov);
-	(void)V1L_Flush(wrk);
+	(void)v1l_flush(v1l, 1);
 	v1l->siov++;
 	v1l->ciov = v1l->siov;
 	v1l->niov = 0;
@@ -46,6 +46,9 @@
 
 /*--------------------------------------------------------------------
  * Read up to len bytes, returning pipelined data first.
+ *
+ * Pipelined data is returned on its own, so that we do not block for
+ * the rest while there is something to pass on.
  */
 
 static ssize_t
@@ -72,7 +75,7 @@ v1f_read(const struct vfp_ctx *vc, struct http_conn *htc, void *d, ssize_t len)
 		if (htc->pipeline_b == htc->pipeline_e)
 			htc->pipeline_b = htc->pipeline_e = NULL;
 	}
-	if (len > 0) {
+	if (l == 0) {
 		i = read(*htc->rfd, p, len);
 		if (i < 0) {
 			// XXX: VTCP_Assert(i); // but also: EAGAIN
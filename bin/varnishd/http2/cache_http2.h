@@ -150,6 +150,7 @@ struct h2_sess {
 	struct sess			*sess;
 	int				refcnt;
 	uint32_t			highest_stream;
+	uint32_t			highest_push;
 	int				bogosity;
 
 	struct h2_req			*req0;
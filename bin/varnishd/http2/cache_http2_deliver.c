@@ -42,6 +42,8 @@
 #include "http2/cache_http2.h"
 
 #include "vct.h"
+#include "vend.h"
+#include "vtim.h"
 
 /**********************************************************************/
 
@@ -144,6 +146,9 @@ h2_minimal_response(struct req *req, uint16_t status)
 	if (status >= 400)
 		req->err_code = status;
 
+	if (r2->state == H2_S_RESV_LOC)
+		r2->state = H2_S_CLOS_REM;
+
 	/* XXX return code checking once H2_Send returns anything but 0 */
 	H2_Send_Get(req->wrk, r2->h2sess, r2);
 	H2_Send(req->wrk, r2,
@@ -173,6 +178,214 @@ h2_enc_len(uint8_t *p, unsigned bits, unsigned val)
 	return (p);
 }
 
+/**********************************************************************
+ * Server push
+ *
+ * We promise the URLs of the "Link: </...>; rel=preload" headers of
+ * the response, and run the pushed requests like any other stream,
+ * except they are cancelled if they cannot be answered from cache.
+ */
+
+static void
+h2_push_url(struct req *preq, struct h2_req *pr2, const char *url,
+    unsigned len)
+{
+	struct worker *wrk;
+	struct h2_sess *h2;
+	struct h2_req *r2;
+	struct req *req;
+	const char *host, *ae;
+	h2_error h2e;
+	uint32_t stream;
+	uint8_t *b, *p;
+	unsigned u, l;
+	char *s;
+
+	wrk = preq->wrk;
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	h2 = pr2->h2sess;
+	CHECK_OBJ_NOTNULL(h2, H2_SESS_MAGIC);
+
+	if (!http_GetHdr(preq->http0, H_Host, &host))
+		return;
+	if (!http_GetHdr(preq->http0, H_Accept_Encoding, &ae))
+		ae = NULL;
+
+	u = WS_Reserve(preq->ws, 0);
+	l = 4 + 2 + 3 * 6 + len + strlen(host) + (ae ? strlen(ae) : 0);
+	if (u < l) {
+		WS_Release(preq->ws, 0);
+		return;
+	}
+
+	Lck_Lock(&h2->sess->mtx);
+	if (h2->error != NULL || !h2->remote_settings.enable_push) {
+		Lck_Unlock(&h2->sess->mtx);
+		WS_Release(preq->ws, 0);
+		return;
+	}
+	h2->highest_push += 2;
+	stream = h2->highest_push;
+	Lck_Unlock(&h2->sess->mtx);
+
+	req = Req_New(wrk, h2->sess);
+	r2 = h2_new_req(wrk, h2, stream, req);
+	AN(r2);
+	r2->state = H2_S_RESV_LOC;
+
+	req->vsl->wid = VXID_Get(wrk, VSL_CLIENTMARKER);
+	VSLb(req->vsl, SLT_Begin, "req %u push", VXID(preq->vsl->wid));
+	VSLb(preq->vsl, SLT_Link, "req %u push", VXID(req->vsl->wid));
+	req->transport = &H2_transport;
+	req->t_first = VTIM_real();
+	req->t_req = req->t_first;
+	req->t_prev = req->t_first;
+	VSLb_ts_req(req, "Start", req->t_first);
+	VCL_Ref(preq->vcl);
+	req->vcl = preq->vcl;
+
+	HTTP_Setup(req->http, req->ws, req->vsl, SLT_ReqMethod);
+	HTTP_Copy(req->http, preq->http0);
+	req->http->ws = req->ws;
+	req->http->vsl = req->vsl;
+	req->http->logtag = SLT_ReqMethod;
+	req->http->conds = 0;
+	s = WS_Copy(req->ws, url, len + 1);
+	AN(s);
+	s[len] = '\0';
+	http_SetH(req->http, HTTP_HDR_URL, s);
+	http_ForceField(req->http, HTTP_HDR_METHOD, "GET");
+	http_Unset(req->http, H_If_Modified_Since);
+	http_Unset(req->http, H_If_None_Match);
+	http_Unset(req->http, H_Range);
+	http_Unset(req->http, H_Content_Length);
+	http_CopyHome(req->http);
+	req->req_body_status = REQ_BODY_NONE;
+	req->hit_only = 1;
+
+	/* The PUSH_PROMISE header block */
+	b = p = (void*)preq->ws->f;
+	vbe32enc(p, stream);
+	p += 4;
+	*p++ = 0x82;				// :method GET
+	*p++ = 0x86;				// :scheme http
+	*p = 0x00;				// :path
+	p = h2_enc_len(p, 4, 4);
+	*p = 0x00;
+	p = h2_enc_len(p, 7, len);
+	memcpy(p, url, len);
+	p += len;
+	*p = 0x00;				// :authority
+	p = h2_enc_len(p, 4, 1);
+	*p = 0x00;
+	p = h2_enc_len(p, 7, strlen(host));
+	memcpy(p, host, strlen(host));
+	p += strlen(host);
+	if (ae != NULL) {
+		*p = 0x00;			// accept-encoding
+		p = h2_enc_len(p, 4, 16);
+		*p = 0x00;
+		p = h2_enc_len(p, 7, strlen(ae));
+		memcpy(p, ae, strlen(ae));
+		p += strlen(ae);
+	}
+	assert(p <= b + u);
+
+	H2_Send_Get(wrk, h2, pr2);
+	h2e = H2_Send(wrk, pr2, H2_F_PUSH_PROMISE,
+	    H2FF_PUSH_PROMISE_END_HEADERS, p - b, b);
+	H2_Send_Rel(h2, pr2);
+
+	if (h2e == NULL) {
+		req->req_step = R_STP_TRANSPORT;
+		req->task.func = h2_do_req;
+		req->task.priv = req;
+		r2->scheduled = 1;
+		if (!Pool_Task(wrk->pool, &req->task, TASK_QUEUE_REQ)) {
+			WS_Release(preq->ws, 0);
+			return;
+		}
+		r2->scheduled = 0;
+		vbe32enc(b, H2SE_REFUSED_STREAM->val);
+		H2_Send_Get(wrk, h2, r2);
+		(void)H2_Send(wrk, r2, H2_F_RST_STREAM, 0, 4, b);
+		H2_Send_Rel(h2, r2);
+	}
+	WS_Release(preq->ws, 0);
+
+	/* Left for the session thread to clean up */
+	r2->state = H2_S_CLOSED;
+}
+
+/* Does the link-param "rel=..." in [b,e) have a "preload" relation ? */
+
+static int
+h2_push_rel(const char *b, const char *e)
+{
+	const char *q;
+
+	if (e - b < 4 || strncasecmp(b, "rel=", 4))
+		return (0);
+	for (b += 4; b < e; b = q) {
+		while (b < e && (*b == '"' || vct_issp(*b)))
+			b++;
+		for (q = b; q < e && *q != '"' && !vct_issp(*q); q++)
+			continue;
+		if (q - b == 7 && !strncasecmp(b, "preload", 7))
+			return (1);
+	}
+	return (0);
+}
+
+static void
+h2_push(struct req *req, struct h2_req *r2)
+{
+	const char *b, *e, *u, *ue, *q;
+	unsigned n = 0, u2;
+	int preload, nopush;
+
+	for (u2 = HTTP_HDR_FIRST; u2 < req->resp->nhd; u2++) {
+		if (!http_IsHdr(&req->resp->hd[u2], H_Link))
+			continue;
+		b = req->resp->hd[u2].b + *H_Link;
+		e = req->resp->hd[u2].e;
+		while (b < e) {
+			/* One link-value: </url>; param; param, ... */
+			while (b < e && (vct_islws(*b) || *b == ','))
+				b++;
+			if (b >= e || *b != '<')
+				break;
+			u = ++b;
+			while (b < e && *b != '>')
+				b++;
+			if (b >= e)
+				break;
+			ue = b++;
+			preload = nopush = 0;
+			while (b < e && *b != ',') {
+				while (b < e && (vct_islws(*b) || *b == ';'))
+					b++;
+				for (q = b; q < e && *q != ';' && *q != ','; q++)
+					continue;
+				if (q - b == 6 && !strncasecmp(b, "nopush", 6))
+					nopush = 1;
+				else if (h2_push_rel(b, q))
+					preload = 1;
+				b = q;
+			}
+			if (!preload || nopush)
+				continue;
+			/* Only local paths, no scheme- or network-paths */
+			if (ue - u < 1 || u[0] != '/' ||
+			    (ue - u > 1 && u[1] == '/'))
+				continue;
+			h2_push_url(req, r2, u, ue - u);
+			if (++n >= cache_param->h2_push_max)
+				return;
+		}
+	}
+}
+
 void __match_proto__(vtr_deliver_f)
 h2_deliver(struct req *req, struct boc *boc, int sendbody)
 {
@@ -193,6 +406,13 @@ h2_deliver(struct req *req, struct boc *boc, int sendbody)
 	sp = req->sp;
 	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
 
+	if (cache_param->h2_push_max > 0 && (r2->stream & 1) &&
+	    http_IsStatus(req->resp, 200))
+		h2_push(req, r2);
+
+	if (r2->state == H2_S_RESV_LOC)
+		r2->state = H2_S_CLOS_REM;
+
 	(void)WS_Reserve(req->ws, 0);
 	p = (void*)req->ws->f;
 
@@ -138,7 +138,9 @@ h2_new_req(const struct worker *wrk, struct h2_sess *h2,
 {
 	struct h2_req *r2;
 
-	ASSERT_RXTHR(h2);
+	/* Only streams we push are created outside the session thread */
+	if (stream == 0 || (stream & 1))
+		ASSERT_RXTHR(h2);
 	if (req == NULL)
 		req = Req_New(wrk, h2->sess);
 	CHECK_OBJ_NOTNULL(req, REQ_MAGIC);
@@ -155,8 +157,8 @@ h2_new_req(const struct worker *wrk, struct h2_sess *h2,
 	req->transport_priv = r2;
 	Lck_Lock(&h2->sess->mtx);
 	VTAILQ_INSERT_TAIL(&h2->streams, r2, list);
-	Lck_Unlock(&h2->sess->mtx);
 	h2->refcnt++;
+	Lck_Unlock(&h2->sess->mtx);
 	return (r2);
 }
 
@@ -365,7 +367,7 @@ h2_rx_priority(struct worker *wrk, struct h2_sess *h2, struct h2_req *r2)
 
 	(void)wrk;
 	ASSERT_RXTHR(h2);
-	xxxassert(r2->stream & 1);
+	(void)r2;
 	return (0);
 }
 
@@ -473,7 +475,8 @@ h2_do_req(struct worker *wrk, void *priv)
 {
 	struct req *req;
 	struct h2_req *r2;
-	const char *b;
+	const char *p;
+	char b[4];
 
 	CAST_OBJ_NOTNULL(req, priv, REQ_MAGIC);
 	CAST_OBJ_NOTNULL(r2, req->transport_priv, H2_REQ_MAGIC);
@@ -485,7 +488,7 @@ h2_do_req(struct worker *wrk, void *priv)
 	http_CollectHdrSep(req->http, H_Cookie, "; ");	// rfc7540,l,3114,3120
 
 	if (req->req_body_status == REQ_BODY_INIT) {
-		if (!http_GetHdr(req->http, H_Content_Length, &b))
+		if (!http_GetHdr(req->http, H_Content_Length, &p))
 			req->req_body_status = REQ_BODY_WITHOUT_LEN;
 		else
 			req->req_body_status = REQ_BODY_WITH_LEN;
@@ -496,6 +499,13 @@ h2_do_req(struct worker *wrk, void *priv)
 	req->http->conds = 1;
 	if (CNT_Request(wrk, req) != REQ_FSM_DISEMBARK) {
 		AZ(req->ws->r);
+		if (r2->state == H2_S_RESV_LOC) {
+			/* Pushed stream which was not a hit */
+			vbe32enc(b, H2SE_CANCEL->val);
+			H2_Send_Get(wrk, r2->h2sess, r2);
+			(void)H2_Send(wrk, r2, H2_F_RST_STREAM, 0, 4, b);
+			H2_Send_Rel(r2->h2sess, r2);
+		}
 		r2->scheduled = 0;
 		r2->state = H2_S_CLOSED;
 		if (r2->h2sess->error)
@@ -532,6 +542,19 @@ h2_end_headers(struct worker *wrk, const struct h2_sess *h2,
 	req->task.func = h2_do_req;
 	req->task.priv = req;
 	r2->scheduled = 1;
+	if (FEATURE(FEATURE_H2_INLINE) &&
+	    req->req_body_status == REQ_BODY_NONE) {
+		/*
+		 * Without a body to receive, the stream does not need
+		 * us to read frames for it, so we can run it right here
+		 * until it either finishes or has to wait for something.
+		 */
+		wrk->stats->req_inline++;
+		req->transport_inline = 1;
+		h2_do_req(wrk, req);
+		THR_SetRequest(h2->srq);
+		return (0);
+	}
 	XXXAZ(Pool_Task(wrk->pool, &req->task, TASK_QUEUE_REQ));
 	return (0);
 }
@@ -647,6 +670,8 @@ h2_rx_data(struct worker *wrk, struct h2_sess *h2, struct h2_req *r2)
 	ASSERT_RXTHR(h2);
 	if (r2 == NULL)
 		return (0);
+	if (!(r2->stream & 1))
+		return (H2SE_STREAM_CLOSED);
 	Lck_Lock(&h2->sess->mtx);
 	AZ(h2->mailcall);
 	h2->mailcall = r2;
@@ -794,22 +819,41 @@ h2_procframe(struct worker *wrk, struct h2_sess *h2,
 	if (h2->rxf_stream > h2->highest_stream && h2f->act_sidle != 0)
 		return (h2f->act_sidle);
 
-	if (h2->rxf_stream != 0 && !(h2->rxf_stream & 1)) {
+	Lck_Lock(&h2->sess->mtx);
+	if (h2->rxf_stream != 0 && !(h2->rxf_stream & 1) &&
+	    h2->rxf_stream > h2->highest_push) {
 		// rfc7540,l,1140,1145
 		// rfc7540,l,1153,1158
-		/* No even streams, we don't do PUSH_PROMISE */
-		Lck_Lock(&h2->sess->mtx);
+		/* No even streams, except those we have pushed */
 		VSLb(h2->vsl, SLT_Debug, "H2: illegal stream (=%u)",
 		    h2->rxf_stream);
 		Lck_Unlock(&h2->sess->mtx);
 		return (H2CE_PROTOCOL_ERROR);
 	}
 
-	VTAILQ_FOREACH_SAFE(r2, &h2->streams, list, r22) {
-		if (r2->state == H2_S_CLOSED && !r2->scheduled)
+	/*
+	 * Workers add pushed streams to the list, but only this thread
+	 * removes streams from it, so r22 stays valid while unlocked.
+	 */
+	r2 = VTAILQ_FIRST(&h2->streams);
+	while (r2 != NULL) {
+		r22 = VTAILQ_NEXT(r2, list);
+		if (r2->state == H2_S_CLOSED && !r2->scheduled) {
+			Lck_Unlock(&h2->sess->mtx);
 			h2_del_req(wrk, r2);
-		else if (r2->stream == h2->rxf_stream)
+			Lck_Lock(&h2->sess->mtx);
+		} else if (r2->stream == h2->rxf_stream)
 			break;
+		r2 = r22;
+	}
+	Lck_Unlock(&h2->sess->mtx);
+
+	if (r2 == NULL && h2->rxf_stream != 0 && !(h2->rxf_stream & 1)) {
+		/* A stream we pushed, which is gone already */
+		if (h2f == H2_F_RST_STREAM || h2f == H2_F_PRIORITY ||
+		    h2f == H2_F_WINDOW_UPDATE)
+			return (0);
+		return (H2SE_STREAM_CLOSED);
 	}
 
 	if (r2 == NULL && h2f->act_sidle == 0) {
@@ -36,6 +36,7 @@
 #include "cache/cache_transport.h"
 #include "cache/cache_filter.h"
 #include "http2/cache_http2.h"
+#include "hash/hash_slinger.h"
 
 #include "vend.h"
 #include "vtim.h"
@@ -359,12 +360,19 @@ h2_reembark(struct worker *wrk, struct req *req)
 	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
 	assert(req->transport == &H2_transport);
 
+	/* Off the session thread for good */
+	req->transport_inline = 0;
+
 	if (!SES_Reschedule_Req(req))
 		return;
 
 	/* Couldn't schedule, ditch */
 	wrk->stats->busy_wakeup--;
 	wrk->stats->busy_killed++;
+	if (req->hash_oc != NULL)
+		(void)HSH_DerefObjCore(wrk, &req->hash_oc, 0);
+	if (req->hash_objhead != NULL)
+		(void)HSH_DerefObjHead(wrk, &req->hash_objhead);
 	AN (req->vcl);
 	VCL_Rel(&req->vcl);
 	Req_AcctLogCharge(wrk->stats, req);
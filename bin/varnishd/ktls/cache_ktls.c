@@ -0,0 +1,188 @@
+/*-
+ * Copyright (c) 2017 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Kernel TLS handover
+ *
+ * We do not speak TLS, but a kernel with kTLS can do the record layer
+ * for us, once somebody has done the handshake and installed the keys.
+ *
+ * For "-a address,KTLS,/path/to/helper.sock" listen sockets, each
+ * accepted connection is handed to a local helper process:
+ *
+ *   - We connect to the helper's unix domain stream socket and send a
+ *     single byte, with the client fd attached as SCM_RIGHTS.
+ *   - The helper does the TLS handshake on its copy of the fd, installs
+ *     the TX and RX keys (TCP_ULP "tls", SOL_TLS TLS_TX/TLS_RX), closes
+ *     its copy and responds with a line starting with "OK".  Anything
+ *     else fails the session.
+ *
+ * After that the connection is plain HTTP/1 to us: reads, writev() and
+ * sendfile() all go through the kernel TLS layer.  Non-data records,
+ * such as alerts, make read(2) fail, which closes the session.
+ */
+
+#include "config.h"
+
+#include "cache/cache.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cache/cache_transport.h"
+#include "common/heritage.h"
+
+#include "vtim.h"
+
+/*--------------------------------------------------------------------*/
+
+static const char *
+vktls_handover(int fd, const char *path, double tmo, char *buf, size_t len)
+{
+	struct sockaddr_un sun;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	struct pollfd pfd;
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} cbuf;
+	const char *err = NULL;
+	ssize_t l;
+	int hfd;
+#ifdef TCP_ULP
+	socklen_t sl;
+#endif
+
+	AN(path);
+	AN(buf);
+	assert(len > 2);
+
+	if (strlen(path) >= sizeof sun.sun_path)
+		return ("helper path too long");
+	memset(&sun, 0, sizeof sun);
+	sun.sun_family = AF_UNIX;
+	bprintf(sun.sun_path, "%s", path);
+
+	hfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (hfd < 0)
+		return ("helper socket() failed");
+	if (connect(hfd, (void*)&sun, sizeof sun)) {
+		closefd(&hfd);
+		return ("helper connect() failed");
+	}
+
+	memset(&msg, 0, sizeof msg);
+	memset(&cbuf, 0, sizeof cbuf);
+	iov.iov_base = TRUST_ME("H");
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf.buf;
+	msg.msg_controllen = sizeof cbuf.buf;
+	cmsg = CMSG_FIRSTHDR(&msg);
+	AN(cmsg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	if (sendmsg(hfd, &msg, 0) != 1) {
+		closefd(&hfd);
+		return ("helper sendmsg() failed");
+	}
+
+	pfd.fd = hfd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, tmo > 0. ? (int)(tmo * 1e3) : 0) != 1)
+		err = "helper timeout";
+	else {
+		l = read(hfd, buf, len - 1);
+		if (l <= 0)
+			err = "helper closed";
+		else {
+			buf[l] = '\0';
+			buf[strcspn(buf, "\r\n")] = '\0';
+			if (strncmp(buf, "OK", 2))
+				err = buf;
+		}
+	}
+	closefd(&hfd);
+	if (err != NULL)
+		return (err);
+
+#ifdef TCP_ULP
+	/* The helper had better have left the kTLS ULP on the socket */
+	sl = len - 1;
+	if (getsockopt(fd, IPPROTO_TCP, TCP_ULP, buf, &sl) || sl < 3 ||
+	    strncmp(buf, "tls", 3))
+		return ("no kTLS on the socket");
+#endif
+	return (NULL);
+}
+
+static void __match_proto__(task_func_t)
+vktls_new_session(struct worker *wrk, void *arg)
+{
+	struct req *req;
+	struct sess *sp;
+	const struct listen_sock *ls;
+	const char *err;
+	char buf[64];
+
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CAST_OBJ_NOTNULL(req, arg, REQ_MAGIC);
+	sp = req->sp;
+	CHECK_OBJ_NOTNULL(sp, SESS_MAGIC);
+	ls = sp->listen_sock;
+	CHECK_OBJ_NOTNULL(ls, LISTEN_SOCK_MAGIC);
+	CHECK_OBJ_NOTNULL(ls->arg, LISTEN_ARG_MAGIC);
+
+	err = vktls_handover(sp->fd, ls->arg->helper,
+	    sp->t_idle + cache_param->timeout_idle - VTIM_real(),
+	    buf, sizeof buf);
+	if (err != NULL) {
+		VSL(SLT_Error, sp->vxid, "KTLS handover: %s", err);
+		Req_Release(req);
+		SES_Delete(sp, SC_TLS_HANDOVER, NAN);
+		return;
+	}
+	SES_SetTransport(wrk, sp, req, &HTTP1_transport);
+}
+
+struct transport KTLS_transport = {
+	.name =			"KTLS",
+	.magic =		TRANSPORT_MAGIC,
+	.new_session =		vktls_new_session,
+};
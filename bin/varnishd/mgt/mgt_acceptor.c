@@ -182,7 +182,15 @@ MAC_Arg(const char *arg)
 		xp = XPORT_Find(av[2]);
 		if (xp == NULL)
 			ARGV_ERR("Unknown protocol '%s'\n", av[2]);
-		if (av[3] != NULL)
+		if (!strcasecmp(av[2], "KTLS")) {
+			if (av[3] == NULL)
+				ARGV_ERR("-a(%s) needs a helper socket\n",
+				    av[2]);
+			la->helper = strdup(av[3]);
+			AN(la->helper);
+		} else if (av[3] != NULL)
+			ARGV_ERR("Too many sub-arguments to -a(%s)\n", av[2]);
+		if (av[3] != NULL && av[4] != NULL)
 			ARGV_ERR("Too many sub-arguments to -a(%s)\n", av[2]);
 	}
 	AN(xp);
@@ -77,6 +77,7 @@ typedef void storage_panic_f(struct vsb *vsb, const struct objcore *oc);
 typedef struct object *sml_getobj_f(struct worker *, struct objcore *);
 typedef struct storage *sml_alloc_f(const struct stevedore *, size_t size);
 typedef void sml_free_f(struct storage *);
+typedef int sml_getfd_f(const struct storage *, off_t *);
 
 /* Prototypes for VCL variable responders */
 #define VRTSTVVAR(nm,vt,ct,def) \
@@ -105,6 +106,7 @@ struct stevedore {
 	sml_alloc_f		*sml_alloc;
 	sml_free_f		*sml_free;
 	sml_getobj_f		*sml_getobj;
+	sml_getfd_f		*sml_getfd;	/* Optional, for sendfile */
 
 	const struct obj_methods
 				*methods;
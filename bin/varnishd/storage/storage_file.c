@@ -482,6 +482,24 @@ smf_free(struct storage *s)
 	Lck_Unlock(&sc->mtx);
 }
 
+/*--------------------------------------------------------------------
+ * The file offset of the storage, the mapping is MAP_SHARED so the
+ * page cache has what was written through ->ptr.
+ */
+
+static int __match_proto__(sml_getfd_f)
+smf_getfd(const struct storage *s, off_t *off)
+{
+	struct smf *smf;
+
+	CHECK_OBJ_NOTNULL(s, STORAGE_MAGIC);
+	CAST_OBJ_NOTNULL(smf, s->priv, SMF_MAGIC);
+	AN(off);
+	assert(s->ptr == smf->ptr);
+	*off = smf->offset;
+	return (smf->sc->fd);
+}
+
 /*--------------------------------------------------------------------*/
 
 const struct stevedore smf_stevedore = {
@@ -491,6 +509,7 @@ const struct stevedore smf_stevedore = {
 	.open		=	smf_open,
 	.sml_alloc	=	smf_alloc,
 	.sml_free	=	smf_free,
+	.sml_getfd	=	smf_getfd,
 	.allocobj	=	SML_allocobj,
 	.panic		=	SML_panic,
 	.methods	=	&SML_methods,
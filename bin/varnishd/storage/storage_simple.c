@@ -233,12 +233,12 @@ sml_objfree(struct worker *wrk, struct objcore *oc)
 }
 
 static int __match_proto__(objiterate_f)
-sml_iterator(struct worker *wrk, struct objcore *oc,
+sml_iterator(struct worker *wrk, struct objcore *oc, ssize_t off,
     void *priv, objiterate_f *func, int final)
 {
 	struct boc *boc;
 	struct object *obj;
-	struct storage *st;
+	struct storage *st, *stn;
 	struct storage *checkpoint = NULL;
 	const struct stevedore *stv;
 	ssize_t checkpoint_len = 0;
@@ -258,9 +258,22 @@ sml_iterator(struct worker *wrk, struct objcore *oc,
 	boc = HSH_RefBoc(oc);
 
 	if (boc == NULL) {
+		/*
+		 * The storage stays put until we are done, unless final,
+		 * so only ask for a flush after the last segment.
+		 * Segments before off are skipped without touching them.
+		 */
 		VTAILQ_FOREACH_SAFE(st, &obj->list, list, checkpoint) {
-			if (ret == 0 && st->len > 0)
-				ret = func(priv, 1, st->ptr, st->len);
+			for (stn = checkpoint; stn != NULL && stn->len == 0;
+			    stn = VTAILQ_NEXT(stn, list))
+				continue;
+			if (off >= st->len) {
+				off -= st->len;
+			} else if (ret == 0) {
+				ret = func(priv, final || stn == NULL,
+				    st->ptr + off, st->len - off);
+				off = 0;
+			}
 			if (final) {
 				VTAILQ_REMOVE(&obj->list, st, list);
 				sml_stv_free(stv, st);
@@ -273,6 +286,16 @@ sml_iterator(struct worker *wrk, struct objcore *oc,
 	p = NULL;
 	l = 0;
 
+	/* Wait for the body to get past off, then start from there */
+	while (len < off) {
+		nl = ObjWaitExtend(wrk, oc, len);
+		if (nl == len)
+			break;
+		len = nl;
+	}
+	if (len > off)
+		len = off;
+
 	while (1) {
 		ol = len;
 		nl = ObjWaitExtend(wrk, oc, ol);
@@ -333,6 +356,46 @@ sml_iterator(struct worker *wrk, struct objcore *oc,
 	return (ret);
 }
 
+/*--------------------------------------------------------------------
+ * Only complete objects, the boc gates the storage list.
+ */
+
+static int __match_proto__(objfileiterator_f)
+sml_fileiterator(struct worker *wrk, struct objcore *oc,
+    void *priv, objsendfile_f *func)
+{
+	struct boc *boc;
+	struct object *obj;
+	struct storage *st;
+	const struct stevedore *stv;
+	int fd, ret = 0;
+	off_t off;
+
+	stv = oc->stobj->stevedore;
+	CHECK_OBJ_NOTNULL(stv, STEVEDORE_MAGIC);
+	if (stv->sml_getfd == NULL)
+		return (1);
+
+	boc = HSH_RefBoc(oc);
+	if (boc != NULL) {
+		HSH_DerefBoc(wrk, oc);
+		return (1);
+	}
+
+	obj = sml_getobj(wrk, oc);
+	CHECK_OBJ_NOTNULL(obj, OBJECT_MAGIC);
+	VTAILQ_FOREACH(st, &obj->list, list) {
+		if (st->len == 0)
+			continue;
+		fd = stv->sml_getfd(st, &off);
+		assert(fd >= 0);
+		ret = func(priv, fd, off, st->len);
+		if (ret)
+			break;
+	}
+	return (ret);
+}
+
 /*--------------------------------------------------------------------
  */
 
@@ -625,6 +688,7 @@ sml_setattr(struct worker *wrk, struct objcore *oc, enum obj_attr attr,
 const struct obj_methods SML_methods = {
 	.objfree	= sml_objfree,
 	.objiterator	= sml_iterator,
+	.objfileiterator = sml_fileiterator,
 	.objgetspace	= sml_getspace,
 	.objextend	= sml_extend,
 	.objtrimstore	= sml_trimstore,
@@ -51,6 +51,16 @@ HIS_PROF(
     8,			// hist_high
     "graph the size of responses"
     )
+HIS_PROF(
+    "writes",		// name
+    HIS_CLIENT,		// HIS_CLIENT | HIS_BACKEND
+    SLT_RespWrites,	// tag
+    HIS_NO_PREFIX,	// prefix
+    1,			// field
+    0,			// hist_low
+    3,			// hist_high
+    "graph the number of write system calls per response"
+    )
 // backend
 HIS_PROF(
     "Bereqtime",	// name
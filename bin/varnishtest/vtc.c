@@ -667,6 +667,10 @@ cmd_delay(CMD_ARGS)
  *
  * SO_RCVTIMEO_WORKS
  *        The SO_RCVTIMEO socket option is working
+ * sendfile
+ *        varnishd was built with sendfile(2) support
+ * brotli
+ *        varnishd was built with brotli support
  * 64bit
  *        The environment is 64 bits
  * !OSX
@@ -720,6 +724,22 @@ cmd_feature(CMD_ARGS)
 #endif
 		}
 
+		if (!strcmp(*av, "sendfile")) {
+#ifdef HAVE_SENDFILE
+			good = 1;
+#else
+			vtc_stop = 2;
+#endif
+		}
+
+		if (!strcmp(*av, "brotli")) {
+#ifdef HAVE_BROTLI
+			good = 1;
+#else
+			vtc_stop = 2;
+#endif
+		}
+
 		if (!strcmp(*av, "!OSX")) {
 #if !defined(__APPLE__) || !defined(__MACH__)
 			good = 1;
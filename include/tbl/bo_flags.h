@@ -33,12 +33,14 @@
 BO_FLAG(do_esi,		1, 1, "")
 BO_FLAG(do_gzip,	1, 1, "")
 BO_FLAG(do_gunzip,	1, 1, "")
+BO_FLAG(do_brotli,	1, 1, "")
 BO_FLAG(do_stream,	1, 1, "")
 BO_FLAG(do_pass,	0, 0, "")
 BO_FLAG(uncacheable,	0, 0, "")
 BO_FLAG(is_gzip,	0, 0, "")
 BO_FLAG(is_gunzip,	0, 0, "")
 BO_FLAG(was_304,	1, 0, "")
+BO_FLAG(gzip_fragment,	0, 0, "")
 #undef BO_FLAG
 
 /*lint -restore */
@@ -67,6 +67,17 @@ FEATURE_BIT(ESI_REMOVE_BOM,		esi_remove_bom,
     "Ignore and remove the UTF-8 BOM (0xeb 0xbb 0xbf) from front of object."
 )
 
+FEATURE_BIT(ESI_ASSEMBLY,		esi_assembly,
+    "Remember the fragments ESI objects include",
+    "Deliver ESI objects with the fragments they included last time,"
+    " as long as all of them are still fresh, unbanned and not"
+    " superseded.  Includes still run vcl_recv{} and vcl_hash{}, and"
+    " a fragment is only reused if the include hashes the same as"
+    " when it was found, but the rest of VCL does not see it.  The"
+    " fragments are kept in storage as long as the ESI object"
+    " including them is."
+)
+
 FEATURE_BIT(HTTPS_SCHEME,		https_scheme,
     "Also split https URIs",
     "Extract host from full URI in the request line if the scheme is https."
@@ -77,6 +88,13 @@ FEATURE_BIT(HTTP2,		http2,
     "Enable HTTP/2 protocol support."
 )
 
+FEATURE_BIT(H2_INLINE,		h2_inline,
+    "Run HTTP/2 cache hits on the session thread",
+    "Process HTTP/2 streams without a request body on the session"
+    " thread, and only hand them to a worker thread when they need"
+    " to wait for a backend or a busy object."
+)
+
 #undef FEATURE_BIT
 
 /*lint -restore */
@@ -34,7 +34,9 @@ LOCK(backend_tcp)
 LOCK(ban)
 LOCK(busyobj)
 LOCK(cli)
+LOCK(esi)
 LOCK(exp)
+LOCK(gzip)
 LOCK(hcb)
 LOCK(lru)
 LOCK(mempool)
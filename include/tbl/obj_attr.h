@@ -49,6 +49,7 @@
 /* upper, lower */
 #ifdef OBJ_AUXATTR
   OBJ_AUXATTR(ESIDATA, esidata)
+  OBJ_AUXATTR(BRBODY, brbody)
   #undef OBJ_AUXATTR
 #endif
 
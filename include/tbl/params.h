@@ -277,6 +277,25 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	backend_latency_decay,
+	/* typ */	timeout,
+	/* min */	"0.1",
+	/* max */	NULL,
+	/* default */	"10",
+	/* units */	"seconds",
+	/* flags */	0,
+	/* s-text */
+	"Time constant of the moving average of each backend's time to "
+	"first byte.\n"
+	"Slower responses raise the average immediately, faster ones "
+	"lower it gradually over about this long, and so does not having "
+	"any responses.\n"
+	"Used by the peak_ewma director.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	cli_buffer,
 	/* typ */	bytes_u,
@@ -355,6 +374,43 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	collapse_revalidation,
+	/* typ */	bool,
+	/* min */	NULL,
+	/* max */	NULL,
+	/* default */	"off",
+	/* units */	"bool",
+	/* flags */	0,
+	/* s-text */
+	"When vcl_hit{} returns miss on an expired object which another "
+	"request is already fetching, wait for that fetch to get its "
+	"response and look the object up again, instead of passing the "
+	"request to the backend.\n"
+	"Requests which have waited once are not held back again, they "
+	"pass if the object is still being fetched.\n"
+	"The waiting request keeps its worker thread, see "
+	"collapse_revalidation_timeout.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
+PARAM(
+	/* name */	collapse_revalidation_timeout,
+	/* typ */	timeout,
+	/* min */	"0.000",
+	/* max */	NULL,
+	/* default */	"5.000",
+	/* units */	"seconds",
+	/* flags */	0,
+	/* s-text */
+	"How long a request waits for another request's revalidation of "
+	"an expired object, with collapse_revalidation.  When it times "
+	"out, the request is served the expired object.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	connect_timeout,
 	/* typ */	timeout,
@@ -527,6 +583,24 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	fetch_park,
+	/* typ */	bool,
+	/* min */	NULL,
+	/* max */	NULL,
+	/* default */	"off",
+	/* units */	"bool",
+	/* flags */	EXPERIMENTAL,
+	/* s-text */
+	"Let body fetches which are waiting for the backend give up their "
+	"worker thread and wait on the waiter instead, so slow backends "
+	"do not tie up a thread per fetch.\n"
+	"Only bodies which go to storage unfiltered, without gzip, "
+	"gunzip or ESI processing, are fetched this way.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	gzip_buffer,
 	/* typ */	bytes_u,
@@ -545,6 +619,28 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	gzip_esi_fragments,
+	/* typ */	bool,
+	/* min */	NULL,
+	/* max */	NULL,
+	/* default */	"off",
+	/* units */	"bool",
+	/* flags */	0,
+	/* s-text */
+	"Gzip the fragments which gzip'ed ESI objects include when they "
+	"are fetched: beresp.do_gzip starts out true for them, and "
+	"vcl_backend_response can set it to false to store a fragment "
+	"as it is.\n"
+	"Fragments which are not gzip'ed are sent in uncompressed gzip "
+	"blocks, as part of a gzip'ed ESI object, so this makes ESI "
+	"objects smaller on the wire.  Gzip'ed fragments are stored "
+	"gzip'ed, and are gunzip'ed when delivered to clients which do "
+	"not support gzip.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	gzip_level,
 	/* typ */	uint,
@@ -574,6 +670,57 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	gzip_parallel,
+	/* typ */	bytes,
+	/* min */	"0",
+	/* max */	NULL,
+	/* default */	"0",
+	/* units */	"bytes",
+	/* flags */	EXPERIMENTAL,
+	/* s-text */
+	"Bodies gzip'ed by varnish with a Content-Length of at least this "
+	"many bytes are cut into 128k blocks, which are compressed in "
+	"parallel by idle worker threads.\n"
+	"This trades a little compression ratio and some memory per "
+	"fetch for a shorter fetch time of large objects.\n"
+	"Zero disables parallel compression.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
+PARAM(
+	/* name */	brotli_level,
+	/* typ */	uint,
+	/* min */	"0",
+	/* max */	"11",
+	/* default */	"6",
+	/* units */	NULL,
+	/* flags */	0,
+	/* s-text */
+	"Brotli compression level for beresp.do_brotli: 0=fast, 11=best.\n"
+	"The compression is done once, at fetch time.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
+PARAM(
+	/* name */	brotli_max_size,
+	/* typ */	bytes,
+	/* min */	"0",
+	/* max */	NULL,
+	/* default */	"16m",
+	/* units */	"bytes",
+	/* flags */	0,
+	/* s-text */
+	"Maximum size of the brotli copy made for beresp.do_brotli.\n"
+	"The copy is built in memory while the object is fetched, if "
+	"it grows past this size it is given up, and the object is "
+	"served without a brotli copy.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	http_gzip_support,
 	/* typ */	bool,
@@ -629,6 +776,21 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	http_range_max,
+	/* typ */	uint,
+	/* min */	"1",
+	/* max */	NULL,
+	/* default */	"16",
+	/* units */	"ranges",
+	/* flags */	0,
+	/* s-text */
+	"Maximum number of ranges in a single Range header.\n"
+	"Requests for more ranges than this get the entire object.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	http_req_hdr_len,
 	/* typ */	bytes_u,
@@ -760,6 +922,27 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	max_esi_prefetch,
+	/* typ */	uint,
+	/* min */	"0",
+	/* max */	NULL,
+	/* default */	"0",
+	/* units */	"includes",
+	/* flags */	0,
+	/* s-text */
+	"Maximum number of esi:include fragments of an ESI object which "
+	"are looked up ahead of their turn when its delivery starts, so "
+	"that fragments missing from the cache are fetched in parallel.\n"
+	"Zero disables prefetching, and all fragments are looked up and "
+	"fetched one after the other while delivering.\n"
+	"When enabled, vcl_recv{}, vcl_hash{} and vcl_hit{} or vcl_miss{} "
+	"run once more for each prefetched fragment.  Fragments which are "
+	"passed or synthesized are left to their turn.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	max_restarts,
 	/* typ */	uint,
@@ -935,6 +1118,23 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	probe_jitter,
+	/* typ */	double,
+	/* min */	"0",
+	/* max */	"0.5",
+	/* default */	"0.1",
+	/* units */	NULL,
+	/* flags */	0,
+	/* s-text */
+	"Spread backend health probes by randomly shortening or "
+	"lengthening each probe interval by up to this fraction of it.\n"
+	"This keeps backends defined at the same time, with the same "
+	"probe, from being polled in synchronized bursts.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 PARAM(
 	/* name */	rush_exponent,
 	/* typ */	uint,
@@ -969,6 +1169,22 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	sendfile_threshold,
+	/* typ */	uint,
+	/* min */	"0",
+	/* max */	NULL,
+	/* default */	"unlimited",
+	/* units */	"bytes",
+	/* flags */	EXPERIMENTAL,
+	/* s-text */
+	"The minimum size of objects transmitted with sendfile.\n"
+	"Only applies to HTTP/1 responses delivered unmodified from a "
+	"complete object in a file backed stevedore, such as -sfile.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 #if 0
 /* actual location mgt_param_tbl.c */
 PARAM(
@@ -1690,6 +1906,25 @@ PARAM(
 	/* func */	NULL
 )
 
+PARAM(
+	/* name */	h2_push_max,
+	/* typ */	uint,
+	/* min */	"0",
+	/* max */	"100",
+	/* default */	"0",
+	/* units */	"streams",
+	/* flags */	EXPERIMENTAL,
+	/* s-text */
+	"Maximum number of streams we push per HTTP2 response.\n"
+	"Candidates are the 'Link: </...>; rel=preload' headers of the "
+	"response, which can also be added in vcl_deliver{}.  Pushed "
+	"requests go through VCL as usual, but are cancelled unless "
+	"they can be delivered from cache.\n"
+	"Zero disables server push.",
+	/* l-text */	"",
+	/* func */	NULL
+)
+
 #undef PARAM
 
 /*lint -restore */
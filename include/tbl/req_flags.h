@@ -33,10 +33,16 @@
 REQ_FLAG(disable_esi,		0, 0, "")
 REQ_FLAG(hash_ignore_busy,	1, 1, "")
 REQ_FLAG(hash_always_miss,	1, 1, "")
+REQ_FLAG(hash_wait_busy,	0, 0, "")
 REQ_FLAG(is_hit,		0, 0, "")
 REQ_FLAG(waitinglist,		0, 0, "")
 REQ_FLAG(want100cont,		0, 0, "")
 REQ_FLAG(late100cont,		0, 0, "")
+REQ_FLAG(transport_inline,	0, 0, "")
+REQ_FLAG(hit_only,		0, 0, "")
+REQ_FLAG(accept_br,		0, 0, "")
+REQ_FLAG(esi_prefetch,		0, 0, "")
+REQ_FLAG(esi_plan,		0, 0, "")
 #undef REQ_FLAG
 
 /*lint -restore */
@@ -54,6 +54,7 @@
   FETCH_STEP(condfetch,		CONDFETCH,	(wrk, bo))
   FETCH_STEP(fetch,		FETCH,		(wrk, bo))
   FETCH_STEP(fetchbody,		FETCHBODY,	(wrk, bo))
+  FETCH_STEP(park,		PARK,		(wrk, bo))
   FETCH_STEP(fetchend,		FETCHEND,	(wrk, bo))
   FETCH_STEP(error,		ERROR,		(wrk, bo))
   FETCH_STEP(fail,		FAIL,		(wrk, bo))
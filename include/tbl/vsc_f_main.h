@@ -153,11 +153,29 @@ VSC_FF(backend_recycle,		uint64_t, 0, 'c', 'i', info,
 	" closes it."
 )
 
+VSC_FF(backend_steal,		uint64_t, 0, 'c', 'i', info,
+    "Backend conn. steals",
+	"Count of backend connection reuses where the connection was"
+	" taken from the idle connections of another thread pool."
+)
+
+VSC_FF(backend_warm,		uint64_t, 0, 'c', 'i', info,
+    "Backend conn. pre-opened",
+	"Count of backend connections opened ahead of demand to keep"
+	" the .min_idle of a backend."
+)
+
 VSC_FF(backend_retry,		uint64_t, 0, 'c', 'i', info,
     "Backend conn. retry",
 	""
 )
 
+VSC_FF(req_body_spooled,	uint64_t, 0, 'c', 'i', info,
+    "Request bodies spooled",
+	"Number of request bodies which were spooled into storage while"
+	" they were sent to the backend, see std.spool_req_body()."
+)
+
 /*---------------------------------------------------------------------
  * Backend fetch statistics
  */
@@ -217,6 +235,13 @@ VSC_FF(fetch_no_thread,		uint64_t, 1, 'c', 'i', info,
 	"beresp fetch failed, no thread available."
 )
 
+VSC_FF(fetch_parked,		uint64_t, 1, 'c', 'i', info,
+    "Fetch parked on the waiter",
+	"Number of times a body fetch released its worker thread to wait"
+	" for the backend to send more data, see the fetch_park"
+	" parameter."
+)
+
 /*---------------------------------------------------------------------
  * Pools, threads, and sessions
  *    see: cache_pool.c
@@ -278,12 +303,47 @@ VSC_FF(busy_wakeup,		uint64_t, 1, 'c', 'i', info,
 	" rescheduled."
 )
 
+VSC_FF(busy_handoff,		uint64_t, 1, 'c', 'i', info,
+    "Number of requests handed the object they waited for",
+	"Number of requests woken from the busy object sleep list with"
+	" the newly fetched object, without looking it up again."
+	" Also counted in busy_wakeup."
+)
+
 VSC_FF(busy_killed,		uint64_t, 1, 'c', 'i', info,
     "Number of requests killed after sleep on busy objhdr",
 	"Number of requests killed from the busy object sleep list"
 	" due to lack of resources."
 )
 
+VSC_FF(busy_revalidate,		uint64_t, 1, 'c', 'i', info,
+    "Number of requests waiting for another revalidation",
+	"Number of requests which found an expired object already being"
+	" fetched, and waited for that fetch rather than going to the"
+	" backend on their own."
+)
+
+VSC_FF(busy_revalidate_stale,	uint64_t, 1, 'c', 'i', info,
+    "Number of requests served stale after waiting",
+	"Number of requests which waited for another revalidation for"
+	" longer than collapse_revalidation_timeout, and were served the"
+	" expired object instead."
+)
+
+VSC_FF(req_inline,		uint64_t, 1, 'c', 'i', info,
+    "Requests started on transport thread",
+	"Number of requests which the transport started on its own"
+	" thread rather than a worker thread."
+	" See also feature h2_inline."
+)
+
+VSC_FF(req_offload,		uint64_t, 1, 'c', 'i', info,
+    "Requests handed to a worker thread",
+	"Number of requests started on a transport thread which were"
+	" handed to a worker thread before blocking on a backend or"
+	" busy object."
+)
+
 VSC_FF(sess_queued,		uint64_t, 0, 'c', 'i', info,
     "Sessions queued for thread",
 	"Number of times session was queued waiting for a thread."
@@ -398,6 +458,12 @@ VSC_FF(s_resp_bodybytes,		uint64_t, 1, 'c', 'B', info,
 	"Total response body bytes transmitted"
 )
 
+VSC_FF(s_resp_sendfile,		uint64_t, 1, 'c', 'B', info,
+    "Response body bytes sent with sendfile",
+	"Response body bytes transmitted directly from the storage file"
+	" with sendfile(2), included in s_resp_bodybytes"
+)
+
 VSC_FF(s_pipe_hdrbytes,		uint64_t, 0, 'c', 'B', info,
     "Pipe request header bytes",
 	"Total request bytes received for piped sessions"
@@ -663,6 +729,21 @@ VSC_FF(esi_warnings,		uint64_t, 0, 'c', 'i', diag,
 	""
 )
 
+VSC_FF(esi_prefetch,		uint64_t, 1, 'c', 'i', info,
+    "ESI includes prefetched",
+	"Number of esi:include fragments looked up ahead of their turn,"
+	" see the max_esi_prefetch parameter.  These lookups are not"
+	" counted as cache hits or misses, the include itself is counted"
+	" when its turn comes."
+)
+
+VSC_FF(esi_assembled,		uint64_t, 1, 'c', 'i', info,
+    "ESI objects assembled",
+	"Number of ESI objects delivered with the fragments they included"
+	" last time, without running a request for each of them,"
+	" see the esi_assembly feature."
+)
+
 /*--------------------------------------------------------------------*/
 
 VSC_FF(vmods,			uint64_t, 0, 'g', 'i', info,
@@ -677,6 +758,12 @@ VSC_FF(n_gzip,			uint64_t, 0, 'c', 'i', info,
 	""
 )
 
+VSC_FF(n_gzip_parallel,		uint64_t, 0, 'c', 'i', info,
+    "Parallel gzip operations",
+	"Gzip operations which compressed blocks in parallel,"
+	" see the gzip_parallel parameter."
+)
+
 VSC_FF(n_gunzip,			uint64_t, 0, 'c', 'i', info,
     "Gunzip operations",
 	""
@@ -689,6 +776,12 @@ VSC_FF(n_test_gunzip,			uint64_t, 0, 'c', 'i', info,
 	" stream while it's inserted in storage."
 )
 
+VSC_FF(n_brotli,			uint64_t, 0, 'c', 'i', info,
+    "Brotli variants",
+	"Brotli compressed copies of object bodies made at fetch"
+	" time, see beresp.do_brotli."
+)
+
 /*--------------------------------------------------------------------*/
 
 VSC_FF(vsm_free,			uint64_t, 0, 'g', 'B', diag,
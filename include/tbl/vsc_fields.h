@@ -249,6 +249,16 @@ VSC_FF(req,			uint64_t, 0, 'c', 'i', info,
 	""
 )
 
+VSC_FF(conn_new,		uint64_t, 0, 'c', 'i', info,
+    "Connections opened on demand",
+	"Backend requests which had to wait for a new connection"
+)
+
+VSC_FF(conn_pooled,		uint64_t, 0, 'c', 'i', info,
+    "Connections taken from the pool",
+	"Backend requests which got an idle connection from the pool"
+)
+
 #endif
 
 /**********************************************************************/
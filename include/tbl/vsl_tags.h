@@ -547,6 +547,11 @@ SLTM(HitMiss, 0, "Hit for miss object in cache.",
 	" hit-for-miss object.\n\n"
 )
 
+SLTM(RespWrites, 0, "Client response write calls",
+	"The number of write system calls used to send an HTTP/1 response"
+	" to the client.\n\n"
+)
+
 #undef NODEF_NOTICE
 #undef SLTM
 
@@ -41,6 +41,8 @@
  *
  * 6.1 (unreleased):
  *	http_CollectHdrSep added
+ *	vrt_backend grew .min_idle and .max_idle fields
+ *	VRT_SpoolReqBody added
  * 6.0 (2017-03-15):
  *	VRT_hit_for_pass added
  *	VRT_ipcmp added
@@ -208,7 +210,9 @@ extern const void * const vrt_magic_string_unset;
 	double				first_byte_timeout;	\
 	double				between_bytes_timeout;	\
 	unsigned			max_connections;	\
-	unsigned			proxy_header;
+	unsigned			proxy_header;		\
+	unsigned			min_idle;		\
+	unsigned			max_idle;
 
 #define VRT_BACKEND_HANDLE()			\
 	do {					\
@@ -222,6 +226,8 @@ extern const void * const vrt_magic_string_unset;
 		DN(between_bytes_timeout);	\
 		DN(max_connections);		\
 		DN(proxy_header);		\
+		DN(min_idle);			\
+		DN(max_idle);			\
 	} while(0)
 
 struct vrt_backend {
@@ -291,6 +297,7 @@ int VRT_acl_match(VRT_CTX, VCL_ACL, VCL_IP);
 /* req related */
 
 VCL_BYTES VRT_CacheReqBody(VRT_CTX, VCL_BYTES maxsize);
+VCL_BOOL VRT_SpoolReqBody(VRT_CTX, VCL_BYTES maxsize);
 
 /* Regexp related */
 void VRT_re_init(void **, const char *);
@@ -562,6 +562,17 @@ sp_variables = [
 		cache.  Defaults to false.
 		"""
 	),
+	('beresp.do_brotli',
+		'BOOL',
+		('backend_response', 'backend_error'),
+		('backend_response', 'backend_error'), """
+		Boolean. Also store a brotli compressed copy of the
+		body, which is delivered instead of the regular body to
+		clients that accept it. Defaults to false. Has no
+		effect on ESI objects, or if Varnish was built without
+		brotli support.
+		"""
+	),
 	('beresp.was_304',
 		'BOOL',
 		('backend_response', 'backend_error'),
@@ -283,11 +283,12 @@ vcc_ParseHostDef(struct vcc *tl, const struct token *t_be, const char *vgcname)
 	struct token *t_host = NULL;
 	struct token *t_port = NULL;
 	struct token *t_hosthdr = NULL;
+	struct token *t_max_idle = NULL;
 	struct fld_spec *fs;
 	struct inifin *ifp;
 	struct vsb *vsb;
 	char *p;
-	unsigned u;
+	unsigned u, min_idle = 0, max_idle = 0;
 	double t;
 
 	fs = vcc_FldSpec(tl,
@@ -300,6 +301,8 @@ vcc_ParseHostDef(struct vcc *tl, const struct token *t_be, const char *vgcname)
 	    "?probe",
 	    "?max_connections",
 	    "?proxy_header",
+	    "?min_idle",
+	    "?max_idle",
 	    NULL);
 
 	SkipToken(tl, '{');
@@ -372,6 +375,17 @@ vcc_ParseHostDef(struct vcc *tl, const struct token *t_be, const char *vgcname)
 			ERRCHK(tl);
 			SkipToken(tl, ';');
 			Fb(tl, 0, "\t.max_connections = %u,\n", u);
+		} else if (vcc_IdIs(t_field, "min_idle")) {
+			min_idle = vcc_UintVal(tl);
+			ERRCHK(tl);
+			SkipToken(tl, ';');
+			Fb(tl, 0, "\t.min_idle = %u,\n", min_idle);
+		} else if (vcc_IdIs(t_field, "max_idle")) {
+			t_max_idle = tl->t;
+			max_idle = vcc_UintVal(tl);
+			ERRCHK(tl);
+			SkipToken(tl, ';');
+			Fb(tl, 0, "\t.max_idle = %u,\n", max_idle);
 		} else if (vcc_IdIs(t_field, "proxy_header")) {
 			t_val = tl->t;
 			u = vcc_UintVal(tl);
@@ -416,6 +430,13 @@ vcc_ParseHostDef(struct vcc *tl, const struct token *t_be, const char *vgcname)
 	vcc_FieldsOk(tl, fs);
 	ERRCHK(tl);
 
+	if (max_idle > 0 && max_idle < min_idle) {
+		VSB_printf(tl->sb,
+		    ".max_idle must not be less than .min_idle\n");
+		vcc_ErrWhere(tl, t_max_idle);
+		return;
+	}
+
 	/* Check that the hostname makes sense */
 	assert(t_host != NULL);
 	Emit_Sockaddr(tl, t_host, t_port);
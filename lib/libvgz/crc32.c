@@ -29,6 +29,7 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "crc32_simd.h"
 
 #define local static
 
@@ -206,8 +207,20 @@ unsigned long ZEXPORT crc32(crc, buf, len)
     const unsigned char FAR *buf;
     uInt len;
 {
+#ifdef CRC32_SIMD
+    uInt n;
+#endif
+
     if (buf == Z_NULL) return 0UL;
 
+#ifdef CRC32_SIMD
+    n = crc32_simd(&crc, buf, len);
+    if (n == len)
+        return crc;
+    buf += n;
+    len -= n;
+#endif /* CRC32_SIMD */
+
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
         make_crc_table();
@@ -0,0 +1,236 @@
+/* crc32_simd.c -- hardware assisted CRC-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * The x86 version folds 64 bytes at a time with carry-less multiplies
+ * (PCLMULQDQ), as described in "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction", Gopal et al., Intel 2009,
+ * and reduces the remainder with Barrett reduction.  The ARMv8 version
+ * uses the CRC32 instructions of the optional CRC extension.
+ *
+ * The instruction sets are checked for at run time, so the library
+ * can still be built for, and run on, CPUs without them.
+ */
+
+/* @(#) $Id$ */
+
+#include "crc32_simd.h"
+
+#ifdef CRC32_SIMD
+
+#include <stdint.h>
+
+int ZLIB_INTERNAL crc32_simd_impl = CRC32_SIMD_UNKNOWN;
+
+#ifdef CRC32_SIMD_PCLMUL
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+local int crc32_simd_probe(void)
+{
+    unsigned a, b, c, d;
+
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+        return CRC32_SIMD_NONE;
+    if ((c & bit_PCLMUL) && (c & bit_SSE4_1))
+        return CRC32_SIMD_X86;
+    return CRC32_SIMD_NONE;
+}
+
+local uint32_t crc32_pclmul OF((uint32_t crc, const unsigned char FAR *buf,
+                                uInt len));
+
+/* len must be at least 64 and a multiple of 16 */
+__attribute__((target("sse4.1,pclmul")))
+local uint32_t crc32_pclmul(crc, buf, len)
+    uint32_t crc;
+    const unsigned char FAR *buf;
+    uInt len;
+{
+    /* Bit reflected fold constants and polynomials from the paper */
+    static const uint64_t __attribute__((aligned(16)))
+        k1k2[] = { 0x0154442bd4, 0x01c6e41596 },
+        k3k4[] = { 0x01751997d0, 0x00ccaa009e },
+        k5k0[] = { 0x0163cd6124, 0x0000000000 },
+        poly[] = { 0x01db710641, 0x01f7011641 };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    buf += 64;
+    len -= 64;
+
+    /* Fold four lanes of 16 bytes in parallel */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    /* Fold the four lanes into one */
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Fold in what is left, 16 bytes at a time */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* 128 -> 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+#endif /* CRC32_SIMD_PCLMUL */
+
+#ifdef CRC32_SIMD_ARMV8
+
+#include <sys/auxv.h>
+#include <arm_acle.h>
+
+#ifndef HWCAP_CRC32
+#  define HWCAP_CRC32 (1 << 7)
+#endif
+
+local int crc32_simd_probe(void)
+{
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+        return CRC32_SIMD_ARM;
+    return CRC32_SIMD_NONE;
+}
+
+local uint32_t crc32_armv8 OF((uint32_t crc, const unsigned char FAR *buf,
+                               uInt len));
+
+__attribute__((target("+crc")))
+local uint32_t crc32_armv8(crc, buf, len)
+    uint32_t crc;
+    const unsigned char FAR *buf;
+    uInt len;
+{
+    uint64_t u8;
+    uint32_t u4;
+
+    while (len > 0 && ((uintptr_t)buf & 7)) {
+        crc = __crc32b(crc, *buf++);
+        len--;
+    }
+    while (len >= 32) {
+        zmemcpy((Bytef *)&u8, buf, 8);
+        crc = __crc32d(crc, u8);
+        zmemcpy((Bytef *)&u8, buf + 8, 8);
+        crc = __crc32d(crc, u8);
+        zmemcpy((Bytef *)&u8, buf + 16, 8);
+        crc = __crc32d(crc, u8);
+        zmemcpy((Bytef *)&u8, buf + 24, 8);
+        crc = __crc32d(crc, u8);
+        buf += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        zmemcpy((Bytef *)&u8, buf, 8);
+        crc = __crc32d(crc, u8);
+        buf += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        zmemcpy((Bytef *)&u4, buf, 4);
+        crc = __crc32w(crc, u4);
+        buf += 4;
+        len -= 4;
+    }
+    while (len-- > 0)
+        crc = __crc32b(crc, *buf++);
+    return crc;
+}
+
+#endif /* CRC32_SIMD_ARMV8 */
+
+/* ========================================================================= */
+uInt ZLIB_INTERNAL crc32_simd(crc, buf, len)
+    unsigned long *crc;
+    const unsigned char FAR *buf;
+    uInt len;
+{
+    uint32_t c;
+
+    /* Racing threads all come to the same conclusion */
+    if (crc32_simd_impl == CRC32_SIMD_UNKNOWN)
+        crc32_simd_impl = crc32_simd_probe();
+    if (len < CRC32_SIMD_MIN)
+        return 0;
+
+    c = (uint32_t)*crc ^ 0xffffffffU;
+    switch (crc32_simd_impl) {
+#ifdef CRC32_SIMD_PCLMUL
+    case CRC32_SIMD_X86:
+        len &= ~(uInt)15;
+        c = crc32_pclmul(c, buf, len);
+        break;
+#endif
+#ifdef CRC32_SIMD_ARMV8
+    case CRC32_SIMD_ARM:
+        c = crc32_armv8(c, buf, len);
+        break;
+#endif
+    default:
+        return 0;
+    }
+    *crc = (unsigned long)(c ^ 0xffffffffU);
+    return len;
+}
+
+#else /* CRC32_SIMD */
+
+/* Keep ISO C happy about empty translation units */
+typedef int crc32_simd_unused;
+
+#endif /* CRC32_SIMD */
@@ -0,0 +1,43 @@
+/* crc32_simd.h -- hardware assisted CRC-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* @(#) $Id$ */
+
+#ifndef CRC32_SIMD_H
+#define CRC32_SIMD_H
+
+#include "zutil.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  define CRC32_SIMD_PCLMUL
+#endif
+#if defined(__aarch64__) && defined(__GNUC__) && defined(__linux__)
+#  define CRC32_SIMD_ARMV8
+#endif
+#if defined(CRC32_SIMD_PCLMUL) || defined(CRC32_SIMD_ARMV8)
+#  define CRC32_SIMD
+#endif
+
+#ifdef CRC32_SIMD
+
+/* Which implementation crc32() uses, decided on first use */
+#define CRC32_SIMD_UNKNOWN  (-1)
+#define CRC32_SIMD_NONE     0
+#define CRC32_SIMD_X86      1
+#define CRC32_SIMD_ARM      2
+extern int ZLIB_INTERNAL crc32_simd_impl;
+
+/* Shortest buffer worth setting up the vector units for */
+#define CRC32_SIMD_MIN      64
+
+/*
+ * Fold a prefix of buf into *crc and return how many bytes were used,
+ * zero if the CPU has no suitable instructions.
+ */
+uInt ZLIB_INTERNAL crc32_simd OF((unsigned long *crc,
+                                  const unsigned char FAR *buf, uInt len));
+
+#endif /* CRC32_SIMD */
+
+#endif /* CRC32_SIMD_H */
@@ -51,6 +51,12 @@
 
 #include "deflate.h"
 
+/* SSE2 is part of the x86_64 baseline, no run time check needed */
+#if defined(__SSE2__) && !defined(UNALIGNED_OK) && !defined(ASMV)
+#  include <emmintrin.h>
+#  define MATCH_SSE2
+#endif
+
 extern const char deflate_copyright[];
 const char deflate_copyright[] =
    " deflate 1.2.8 Copyright 1995-2013 Jean-loup Gailly and Mark Adler ";
@@ -92,6 +98,9 @@ local int read_buf        OF((z_streamp strm, Bytef *buf, unsigned size));
 #else
 local uInt longest_match  OF((deflate_state *s, IPos cur_match));
 #endif
+#ifdef MATCH_SSE2
+local uInt match_sse2     OF((const Bytef *scan, const Bytef *match));
+#endif
 
 #ifdef DEBUG
 local  void check_match OF((deflate_state *s, IPos start, IPos match,
@@ -1146,6 +1155,32 @@ local void lm_init (s)
  *   string (strstart) and its distance is <= MAX_DIST, and prev_length >= 1
  * OUT assertion: the match length is not greater than s->lookahead.
  */
+#ifdef MATCH_SSE2
+/* ===========================================================================
+ * Return how many of the MAX_MATCH-2 bytes at scan and match are equal
+ * before the first difference, comparing 16 bytes at a time.  Like the
+ * scalar loop in longest_match(), this may look at window bytes beyond
+ * the lookahead, and the caller limits the result to it.
+ */
+local uInt match_sse2(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    __m128i a, b;
+    unsigned m;
+    uInt n;
+
+    for (n = 0; n < MAX_MATCH - 2; n += 16) {
+        a = _mm_loadu_si128((const __m128i *)(scan + n));
+        b = _mm_loadu_si128((const __m128i *)(match + n));
+        m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+        if (m != 0xffff)
+            return n + (uInt)__builtin_ctz(~m);
+    }
+    return n;
+}
+#endif /* MATCH_SSE2 */
+
 #ifndef ASMV
 /* For 80x86 and 680x0, an optimized version will be provided in match.asm or
  * match.S. The code will be functionally equivalent.
@@ -1176,7 +1211,9 @@ local uInt longest_match(s, cur_match)
     register ush scan_start = *(ushf*)scan;
     register ush scan_end   = *(ushf*)(scan+best_len-1);
 #else
+#ifndef MATCH_SSE2
     register Bytef *strend = s->window + s->strstart + MAX_MATCH;
+#endif
     register Byte scan_end1  = scan[best_len-1];
     register Byte scan_end   = scan[best_len];
 #endif
@@ -1255,6 +1292,10 @@ local uInt longest_match(s, cur_match)
          * are always equal when the other bytes match, given that
          * the hash keys are equal and that HASH_BITS >= 8.
          */
+#ifdef MATCH_SSE2
+        Assert(scan[2] == match[1], "match[2]?");
+        len = 2 + (int)match_sse2(scan + 2, match + 1);
+#else
         scan += 2, match++;
         Assert(*scan == *match, "match[2]?");
 
@@ -1272,6 +1313,7 @@ local uInt longest_match(s, cur_match)
 
         len = MAX_MATCH - (int)(strend - scan);
         scan = strend - MAX_MATCH;
+#endif /* MATCH_SSE2 */
 
 #endif /* UNALIGNED_OK */
 
@@ -0,0 +1,358 @@
+/*-
+ * Copyright (c) 2017 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Throughput benchmark for libvgz
+ *
+ *	vgz_bench [-n rounds] [file ...]
+ *
+ * Without files, synthetic HTML and JSON bodies are used.  For each
+ * body we report the throughput of crc32(), with and without the
+ * hardware assisted version, and of gzip level 6 deflate and inflate.
+ * The hardware CRC is checked against the table driven one on all
+ * lengths up to 4k and all alignments first, and the body must make
+ * it through deflate and inflate unharmed.
+ *
+ * The deflate match loop is selected at compile time, so to compare
+ * it, build this once with and once without -mno-sse2.
+ */
+
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zutil.h"
+#include "crc32_simd.h"
+
+struct corpus {
+	const char	*name;
+	unsigned char	*ptr;
+	uInt		len;
+};
+
+static const char * const words[] = {
+	"varnish", "cache", "request", "backend", "object", "header",
+	"content", "storage", "worker", "session", "the", "a", "of", "and",
+	"to", "in", "is", "for", "with", "on", "by", "from", "gzip", "esi",
+};
+#define NWORDS (sizeof words / sizeof words[0])
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	(void)gettimeofday(&tv, NULL);
+	return (tv.tv_sec + 1e-6 * tv.tv_usec);
+}
+
+static void
+append(struct corpus *c, size_t *sz, const char *s)
+{
+	size_t l = strlen(s);
+
+	while (c->len + l + 1 > *sz) {
+		*sz *= 2;
+		c->ptr = realloc(c->ptr, *sz);
+		if (c->ptr == NULL) {
+			perror("realloc");
+			exit(2);
+		}
+	}
+	memcpy(c->ptr + c->len, s, l + 1);
+	c->len += l;
+}
+
+static void
+mk_html(struct corpus *c, uInt len)
+{
+	char buf[256];
+	size_t sz = 4096;
+	int i;
+
+	c->name = "html";
+	c->ptr = malloc(sz);
+	c->len = 0;
+	append(c, &sz, "<!DOCTYPE html>\n<html><head><title>Bench</title>"
+	    "</head>\n<body>\n");
+	for (i = 0; c->len < len; i++) {
+		(void)snprintf(buf, sizeof buf,
+		    "<div class=\"item item-%d\"><a href=\"/article/%ld\">%s "
+		    "%s</a>\n<p>%s %s %s %s.</p></div>\n",
+		    i % 7, random() % 100000,
+		    words[random() % NWORDS], words[random() % NWORDS],
+		    words[random() % NWORDS], words[random() % NWORDS],
+		    words[random() % NWORDS], words[random() % NWORDS]);
+		append(c, &sz, buf);
+	}
+}
+
+static void
+mk_json(struct corpus *c, uInt len)
+{
+	char buf[256];
+	size_t sz = 4096;
+	int i;
+
+	c->name = "json";
+	c->ptr = malloc(sz);
+	c->len = 0;
+	append(c, &sz, "[\n");
+	for (i = 0; c->len < len; i++) {
+		(void)snprintf(buf, sizeof buf,
+		    "{\"id\":%d,\"name\":\"%s-%s\",\"price\":%ld.%02ld,"
+		    "\"tags\":[\"%s\",\"%s\"],\"active\":%s},\n",
+		    i, words[random() % NWORDS], words[random() % NWORDS],
+		    random() % 1000, random() % 100,
+		    words[random() % NWORDS], words[random() % NWORDS],
+		    random() & 1 ? "true" : "false");
+		append(c, &sz, buf);
+	}
+	append(c, &sz, "{}]\n");
+}
+
+static void
+mk_file(struct corpus *c, const char *fn)
+{
+	struct stat st;
+	ssize_t l;
+	int fd;
+
+	fd = open(fn, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) || st.st_size == 0) {
+		perror(fn);
+		exit(2);
+	}
+	c->name = fn;
+	c->len = st.st_size;
+	c->ptr = malloc(c->len);
+	l = read(fd, c->ptr, c->len);
+	if (l != (ssize_t)c->len) {
+		perror(fn);
+		exit(2);
+	}
+	(void)close(fd);
+}
+
+/*
+ * Compare the hardware CRC with the table driven one, across the
+ * CRC32_SIMD_MIN cut-over and the odd tails.
+ */
+
+static int
+check_crc(const struct corpus *c)
+{
+#ifdef CRC32_SIMD
+	unsigned long a, b;
+	uInt o, l;
+	int impl;
+
+	(void)crc32(0L, c->ptr, 1);
+	impl = crc32_simd_impl;
+	if (impl == CRC32_SIMD_NONE)
+		return (0);
+	for (o = 0; o < 16; o++) {
+		for (l = 0; l <= 4096 && o + l <= c->len; l++) {
+			crc32_simd_impl = CRC32_SIMD_NONE;
+			a = crc32(0x12345678UL, c->ptr + o, l);
+			crc32_simd_impl = impl;
+			b = crc32(0x12345678UL, c->ptr + o, l);
+			if (a != b) {
+				fprintf(stderr,
+				    "%s: CRC mismatch at offset %u len %u:"
+				    " %08lx != %08lx\n", c->name, o, l, a, b);
+				return (-1);
+			}
+		}
+	}
+#else
+	(void)c;
+#endif
+	return (0);
+}
+
+static double
+bench_crc(const struct corpus *c, int rounds)
+{
+	unsigned long crc = 0;
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < rounds; i++)
+		crc = crc32(crc, c->ptr, c->len);
+	t = now() - t;
+	if (crc == 1)		/* Don't let the compiler skip the work */
+		printf(" ");
+	return (1e-6 * c->len * rounds / t);
+}
+
+static int
+bench_gzip(const struct corpus *c, int rounds, double *dmbs, double *imbs,
+    double *ratio)
+{
+	z_stream vz;
+	unsigned char *gz, *out;
+	uLong gzsz, gzlen = 0;
+	double t;
+	int i;
+
+	gzsz = c->len + (c->len >> 8) + 1024;
+	gz = malloc(gzsz);
+	out = malloc(c->len + 1);
+	if (gz == NULL || out == NULL) {
+		perror("malloc");
+		exit(2);
+	}
+
+	t = now();
+	for (i = 0; i < rounds; i++) {
+		memset(&vz, 0, sizeof vz);
+		if (deflateInit2(&vz, 6, Z_DEFLATED, 16 + 15, 8,
+		    Z_DEFAULT_STRATEGY) != Z_OK)
+			return (-1);
+		vz.next_in = c->ptr;
+		vz.avail_in = c->len;
+		vz.next_out = gz;
+		vz.avail_out = gzsz;
+		if (deflate(&vz, Z_FINISH) != Z_STREAM_END)
+			return (-1);
+		gzlen = vz.total_out;
+		(void)deflateEnd(&vz);
+	}
+	*dmbs = 1e-6 * c->len * rounds / (now() - t);
+	*ratio = (double)c->len / gzlen;
+
+	t = now();
+	for (i = 0; i < rounds; i++) {
+		memset(&vz, 0, sizeof vz);
+		if (inflateInit2(&vz, 31) != Z_OK)
+			return (-1);
+		vz.next_in = gz;
+		vz.avail_in = gzlen;
+		vz.next_out = out;
+		vz.avail_out = c->len + 1;
+		if (inflate(&vz, Z_FINISH) != Z_STREAM_END ||
+		    vz.total_out != c->len)
+			return (-1);
+		(void)inflateEnd(&vz);
+	}
+	*imbs = 1e-6 * c->len * rounds / (now() - t);
+
+	free(gz);
+	if (memcmp(out, c->ptr, c->len)) {
+		free(out);
+		return (-1);
+	}
+	free(out);
+	return (0);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: vgz_bench [-n rounds] [file ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char * const *argv)
+{
+	struct corpus *cs, *c;
+	double table = 0., simd = 0., dmbs, imbs, ratio;
+	int i, nc, rounds = 20, impl = 0, retval = 0;
+
+	while ((i = getopt(argc, argv, "n:")) != -1) {
+		switch (i) {
+		case 'n':
+			rounds = atoi(optarg);
+			if (rounds < 1)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	srandom(1);
+	nc = argc > 0 ? argc : 2;
+	cs = calloc(nc, sizeof *cs);
+	if (cs == NULL)
+		return (2);
+	if (argc > 0) {
+		for (i = 0; i < argc; i++)
+			mk_file(&cs[i], argv[i]);
+	} else {
+		mk_html(&cs[0], 4 << 20);
+		mk_json(&cs[1], 4 << 20);
+	}
+
+#ifdef CRC32_SIMD
+	(void)crc32(0L, cs[0].ptr, CRC32_SIMD_MIN);
+	impl = crc32_simd_impl;
+#endif
+	printf("hardware crc32: %s\n",
+#ifdef CRC32_SIMD
+	    impl == CRC32_SIMD_X86 ? "pclmul" :
+	    impl == CRC32_SIMD_ARM ? "armv8" :
+#endif
+	    "none");
+	printf("%-12s %10s %12s %12s %12s %12s %8s\n", "corpus", "bytes",
+	    "crc table", "crc hw", "deflate", "inflate", "ratio");
+
+	for (i = 0; i < nc; i++) {
+		c = &cs[i];
+		if (check_crc(c)) {
+			retval = 1;
+			continue;
+		}
+#ifdef CRC32_SIMD
+		crc32_simd_impl = CRC32_SIMD_NONE;
+		table = bench_crc(c, rounds * 10);
+		crc32_simd_impl = impl;
+		simd = bench_crc(c, rounds * 10);
+#else
+		table = simd = bench_crc(c, rounds * 10);
+#endif
+		if (bench_gzip(c, rounds, &dmbs, &imbs, &ratio)) {
+			fprintf(stderr, "%s: gzip round trip failed\n",
+			    c->name);
+			retval = 1;
+			continue;
+		}
+		printf("%-12s %10u %7.0f MB/s %7.0f MB/s %7.1f MB/s "
+		    "%7.1f MB/s %7.2f\n", c->name, c->len,
+		    table, simd, dmbs, imbs, ratio);
+		free(c->ptr);
+	}
+	free(cs);
+	return (retval);
+}
@@ -51,22 +51,11 @@ struct vmod_debug_dyn {
 };
 
 static void
-dyn_dir_init(VRT_CTX, struct vmod_debug_dyn *dyn,
-    VCL_STRING addr, VCL_STRING port)
+dyn_resolve(struct vrt_backend *vrt, struct suckaddr **sap, VCL_STRING addr,
+    VCL_STRING port)
 {
 	struct addrinfo hints, *res = NULL;
 	struct suckaddr *sa;
-	struct director *dir, *dir2;
-	struct vrt_backend vrt;
-
-	CHECK_OBJ_NOTNULL(dyn, VMOD_DEBUG_DYN_MAGIC);
-	XXXAN(addr);
-	XXXAN(port);
-
-	INIT_OBJ(&vrt, VRT_BACKEND_MAGIC);
-	vrt.port = port;
-	vrt.vcl_name = dyn->vcl_name;
-	vrt.hosthdr = addr;
 
 	memset(&hints, 0, sizeof(hints));
 	hints.ai_family = AF_UNSPEC;
@@ -77,15 +66,40 @@ dyn_dir_init(VRT_CTX, struct vmod_debug_dyn *dyn,
 	sa = VSA_Malloc(res->ai_addr, res->ai_addrlen);
 	AN(sa);
 	if (VSA_Get_Proto(sa) == AF_INET) {
-		vrt.ipv4_addr = addr;
-		vrt.ipv4_suckaddr = sa;
+		XXXAZ(vrt->ipv4_suckaddr);
+		vrt->ipv4_addr = addr;
+		vrt->ipv4_suckaddr = sa;
 	} else if (VSA_Get_Proto(sa) == AF_INET6) {
-		vrt.ipv6_addr = addr;
-		vrt.ipv6_suckaddr = sa;
+		XXXAZ(vrt->ipv6_suckaddr);
+		vrt->ipv6_addr = addr;
+		vrt->ipv6_suckaddr = sa;
 	} else
 		WRONG("Wrong proto family");
 
 	freeaddrinfo(res);
+	*sap = sa;
+}
+
+static void
+dyn_dir_init(VRT_CTX, struct vmod_debug_dyn *dyn,
+    VCL_STRING addr, VCL_STRING port, VCL_STRING addr2)
+{
+	struct suckaddr *sa, *sa2 = NULL;
+	struct director *dir, *dir2;
+	struct vrt_backend vrt;
+
+	CHECK_OBJ_NOTNULL(dyn, VMOD_DEBUG_DYN_MAGIC);
+	XXXAN(addr);
+	XXXAN(port);
+
+	INIT_OBJ(&vrt, VRT_BACKEND_MAGIC);
+	vrt.port = port;
+	vrt.vcl_name = dyn->vcl_name;
+	vrt.hosthdr = addr;
+
+	dyn_resolve(&vrt, &sa, addr, port);
+	if (addr2 != NULL && *addr2 != '\0')
+		dyn_resolve(&vrt, &sa2, addr2, port);
 
 	dir = VRT_new_backend(ctx, &vrt);
 	AN(dir);
@@ -104,11 +118,13 @@ dyn_dir_init(VRT_CTX, struct vmod_debug_dyn *dyn,
 		VRT_delete_backend(ctx, &dir2);
 
 	free(sa);
+	free(sa2);
 }
 
 VCL_VOID
 vmod_dyn__init(VRT_CTX, struct vmod_debug_dyn **dynp,
-    const char *vcl_name, VCL_STRING addr, VCL_STRING port)
+    const char *vcl_name, VCL_STRING addr, VCL_STRING port,
+    VCL_STRING addr2)
 {
 	struct vmod_debug_dyn *dyn;
 
@@ -132,7 +148,7 @@ vmod_dyn__init(VRT_CTX, struct vmod_debug_dyn **dynp,
 
 	AZ(pthread_mutex_init(&dyn->mtx, NULL));
 
-	dyn_dir_init(ctx, dyn, addr, port);
+	dyn_dir_init(ctx, dyn, addr, port, addr2);
 	XXXAN(dyn->dir);
 	*dynp = dyn;
 }
@@ -169,5 +185,5 @@ vmod_dyn_refresh(VRT_CTX, struct vmod_debug_dyn *dyn,
 {
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(dyn, VMOD_DEBUG_DYN_MAGIC);
-	dyn_dir_init(ctx, dyn, addr, port);
+	dyn_dir_init(ctx, dyn, addr, port, NULL);
 }
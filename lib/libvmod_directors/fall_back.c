@@ -61,7 +61,8 @@ vmod_fallback_resolve(const struct director *dir, struct worker *wrk,
     struct busyobj *bo)
 {
 	struct vmod_directors_fallback *fb;
-	unsigned u;
+	const struct vdir_set *vs;
+	unsigned u, start, cur = 0;
 	VCL_BACKEND be = NULL;
 
 	CHECK_OBJ_NOTNULL(dir, DIRECTOR_MAGIC);
@@ -69,19 +70,32 @@ vmod_fallback_resolve(const struct director *dir, struct worker *wrk,
 	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
 	CAST_OBJ_NOTNULL(fb, dir->priv, VMOD_DIRECTORS_FALLBACK_MAGIC);
 
-	vdir_wrlock(fb->vd);
-	if (!fb->st)
-		fb->cur = 0;
-	for (u = 0; u < fb->vd->n_backend; u++) {
-		be = fb->vd->backend[fb->cur];
+	vs = vdir_set(fb->vd);
+	if (fb->st) {
+		cur = fb->cur;
+		if (cur >= vs->n_backend)
+			cur = 0;
+	}
+	start = cur;
+	for (u = 0; u < vs->n_backend; u++) {
+		be = vs->backend[cur];
 		CHECK_OBJ_NOTNULL(be, DIRECTOR_MAGIC);
 		if (be->healthy(be, bo, NULL))
 			break;
-		if (++fb->cur == fb->vd->n_backend)
-			fb->cur = 0;
+		if (++cur == vs->n_backend)
+			cur = 0;
+	}
+	/*
+	 * Our position is only good for the set we picked from, and
+	 * remove_backend() moves it along with the set it publishes.
+	 */
+	if (fb->st && cur != start) {
+		vdir_lock(fb->vd);
+		if (vdir_set(fb->vd) == vs)
+			fb->cur = cur;
+		vdir_unlock(fb->vd);
 	}
-	vdir_unlock(fb->vd);
-	if (u == fb->vd->n_backend)
+	if (u == vs->n_backend)
 		be = NULL;
 	return (be);
 }
@@ -122,7 +136,7 @@ vmod_fallback_add_backend(VRT_CTX,
 
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(fb, VMOD_DIRECTORS_FALLBACK_MAGIC);
-	(void)vdir_add_backend(fb->vd, be, 0.0);
+	(void)vdir_add_backend(ctx, fb->vd, be, 0.0);
 }
 
 VCL_VOID __match_proto__()
@@ -131,7 +145,7 @@ vmod_fallback_remove_backend(VRT_CTX,
 {
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(fb, VMOD_DIRECTORS_FALLBACK_MAGIC);
-	vdir_remove_backend(fb->vd, be, &fb->cur);
+	vdir_remove_backend(ctx, fb->vd, be, &fb->cur);
 }
 
 VCL_BACKEND __match_proto__()
@@ -0,0 +1,141 @@
+/*-
+ * Copyright (c) 2017 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "cache/cache.h"
+#include "cache/cache_director.h"
+
+#include "vrt.h"
+
+#include "vdir.h"
+
+#include "vcc_if.h"
+
+struct vmod_directors_least_connections {
+	unsigned				magic;
+#define VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC		0x5e3a06d1
+	struct vdir				*vd;
+};
+
+/*
+ * Directors have no connections of their own, and count as idle.
+ */
+
+static double __match_proto__(vdir_cost_f)
+vmod_lc_cost(VCL_BACKEND be, double weight)
+{
+	unsigned n = 0;
+
+	CHECK_OBJ_NOTNULL(be, DIRECTOR_MAGIC);
+	if (weight <= 0.)
+		return (HUGE_VAL);
+	if (be->load != NULL)
+		n = be->load(be, NULL);
+	return ((n + 1.) / weight);
+}
+
+static unsigned __match_proto__(vdi_healthy)
+vmod_lc_healthy(const struct director *dir, const struct busyobj *bo,
+    double *changed)
+{
+	struct vmod_directors_least_connections *rr;
+
+	CAST_OBJ_NOTNULL(rr, dir->priv, VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC);
+	return (vdir_any_healthy(rr->vd, bo, changed));
+}
+
+static const struct director * __match_proto__(vdi_resolve_f)
+vmod_lc_resolve(const struct director *dir, struct worker *wrk,
+    struct busyobj *bo)
+{
+	struct vmod_directors_least_connections *rr;
+
+	CHECK_OBJ_NOTNULL(dir, DIRECTOR_MAGIC);
+	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
+	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
+	CAST_OBJ_NOTNULL(rr, dir->priv, VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC);
+	return (vdir_pick_least(rr->vd, bo, vmod_lc_cost));
+}
+
+VCL_VOID __match_proto__()
+vmod_least_connections__init(VRT_CTX,
+    struct vmod_directors_least_connections **rrp, const char *vcl_name)
+{
+	struct vmod_directors_least_connections *rr;
+
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	AN(rrp);
+	AZ(*rrp);
+	ALLOC_OBJ(rr, VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC);
+	AN(rr);
+	*rrp = rr;
+	vdir_new(&rr->vd, "least_connections", vcl_name, vmod_lc_healthy,
+	    vmod_lc_resolve, rr);
+}
+
+VCL_VOID __match_proto__()
+vmod_least_connections__fini(struct vmod_directors_least_connections **rrp)
+{
+	struct vmod_directors_least_connections *rr;
+
+	rr = *rrp;
+	*rrp = NULL;
+	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC);
+	vdir_delete(&rr->vd);
+	FREE_OBJ(rr);
+}
+
+VCL_VOID __match_proto__()
+vmod_least_connections_add_backend(VRT_CTX,
+    struct vmod_directors_least_connections *rr, VCL_BACKEND be, double w)
+{
+
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC);
+	(void)vdir_add_backend(ctx, rr->vd, be, w);
+}
+
+VCL_VOID __match_proto__()
+vmod_least_connections_remove_backend(VRT_CTX,
+    struct vmod_directors_least_connections *rr, VCL_BACKEND be)
+{
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC);
+	vdir_remove_backend(ctx, rr->vd, be, NULL);
+}
+
+VCL_BACKEND __match_proto__()
+vmod_least_connections_backend(VRT_CTX,
+    struct vmod_directors_least_connections *rr)
+{
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_LEAST_CONNECTIONS_MAGIC);
+	return (rr->vd->dir);
+}
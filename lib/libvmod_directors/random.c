@@ -33,7 +33,6 @@
 #include "cache/cache.h"
 #include "cache/cache_director.h"
 
-#include "vbm.h"
 #include "vrnd.h"
 #include "vrt.h"
 
@@ -110,7 +109,7 @@ vmod_random_add_backend(VRT_CTX,
 
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_RANDOM_MAGIC);
-	(void)vdir_add_backend(rr->vd, be, w);
+	(void)vdir_add_backend(ctx, rr->vd, be, w);
 }
 
 VCL_VOID vmod_random_remove_backend(VRT_CTX,
@@ -118,7 +117,7 @@ VCL_VOID vmod_random_remove_backend(VRT_CTX,
 {
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_RANDOM_MAGIC);
-	vdir_remove_backend(rr->vd, be, NULL);
+	vdir_remove_backend(ctx, rr->vd, be, NULL);
 }
 
 VCL_BACKEND __match_proto__()
@@ -60,6 +60,7 @@ vmod_rr_resolve(const struct director *dir, struct worker *wrk,
     struct busyobj *bo)
 {
 	struct vmod_directors_round_robin *rr;
+	const struct vdir_set *vs;
 	unsigned u;
 	VCL_BACKEND be = NULL;
 	unsigned nxt;
@@ -68,17 +69,16 @@ vmod_rr_resolve(const struct director *dir, struct worker *wrk,
 	CHECK_OBJ_NOTNULL(wrk, WORKER_MAGIC);
 	CHECK_OBJ_NOTNULL(bo, BUSYOBJ_MAGIC);
 	CAST_OBJ_NOTNULL(rr, dir->priv, VMOD_DIRECTORS_ROUND_ROBIN_MAGIC);
-	vdir_rdlock(rr->vd);
-	for (u = 0; u < rr->vd->n_backend; u++) {
-		nxt = rr->nxt %= rr->vd->n_backend;
-		be = rr->vd->backend[nxt];
-		rr->nxt++;
+	vs = vdir_set(rr->vd);
+	for (u = 0; u < vs->n_backend; u++) {
+		nxt = rr->nxt % vs->n_backend;
+		rr->nxt = nxt + 1;
+		be = vs->backend[nxt];
 		CHECK_OBJ_NOTNULL(be, DIRECTOR_MAGIC);
 		if (be->healthy(be, bo, NULL))
 			break;
 	}
-	vdir_unlock(rr->vd);
-	if (u == rr->vd->n_backend)
+	if (u == vs->n_backend)
 		be = NULL;
 	return (be);
 }
@@ -118,7 +118,7 @@ vmod_round_robin_add_backend(VRT_CTX,
 
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_ROUND_ROBIN_MAGIC);
-	(void)vdir_add_backend(rr->vd, be, 0.0);
+	(void)vdir_add_backend(ctx, rr->vd, be, 0.0);
 }
 
 VCL_VOID __match_proto__()
@@ -127,7 +127,7 @@ vmod_round_robin_remove_backend(VRT_CTX,
 {
 	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(rr, VMOD_DIRECTORS_ROUND_ROBIN_MAGIC);
-	vdir_remove_backend(rr->vd, be, NULL);
+	vdir_remove_backend(ctx, rr->vd, be, NULL);
 }
 
 VCL_BACKEND __match_proto__()
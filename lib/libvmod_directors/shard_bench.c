@@ -0,0 +1,285 @@
+/*-
+ * Copyright (c) 2017 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Benchmark for the shard director layouts
+ *
+ *	shard_bench [-r replicas] [-k keys] [backends ...]
+ *
+ * For each layout and number of backends (10, 100 and 500 by default)
+ * we report the size of the circle, how long building and looking up
+ * keys on it takes, the largest and smallest share of the keys any
+ * backend gets relative to a fair share, and which fraction of the keys
+ * move to another backend when one is added, and when one is removed
+ * the way the director does it, next to the ideal fraction.
+ *
+ * Backends are named like in VCL and hashed with SHA256, the default.
+ */
+
+#include "config.h"
+
+#include <sys/time.h>
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vdef.h"
+#include "vas.h"
+#include "vend.h"
+#include "vsha256.h"
+
+#include "shard_parse_vcc_enums.h"
+#include "shard_layout.h"
+
+struct circle {
+	enum layout_e			layout;
+	struct shard_circlepoint	*points;
+	unsigned			n_points;
+	unsigned			*lut;
+	unsigned			shift;
+};
+
+static const struct {
+	enum layout_e			layout;
+	const char			*name;
+} layouts[] = {
+	{ RING,		"RING" },
+	{ MAGLEV,	"MAGLEV" },
+	{ JUMP,		"JUMP" },
+};
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	(void)gettimeofday(&tv, NULL);
+	return (tv.tv_sec + 1e-6 * tv.tv_usec);
+}
+
+/* Same as the director's SHA256 */
+static uint32_t
+hash_sha256(const char *s)
+{
+	struct SHA256Context sha256;
+	union {
+		unsigned char digest[32];
+		uint32_t uint32_digest[8];
+	} sha256_digest;
+	uint32_t r;
+
+	SHA256_Init(&sha256);
+	SHA256_Update(&sha256, s, strlen(s));
+	SHA256_Final(sha256_digest.digest, &sha256);
+	vle32enc(&r, sha256_digest.uint32_digest[7]);
+	return (r);
+}
+
+static void
+build(struct circle *c, enum layout_e layout, const char * const *ident,
+    unsigned n, unsigned replicas)
+{
+
+	memset(c, 0, sizeof *c);
+	c->layout = layout;
+	c->points = shard_layout(layout, ident, n, replicas, hash_sha256,
+	    &c->n_points);
+	if (layout == RING)
+		c->lut = shard_layout_lut(c->points, c->n_points, &c->shift);
+}
+
+static void
+destroy(struct circle *c)
+{
+
+	free(c->points);
+	free(c->lut);
+}
+
+static const char *
+lookup(const struct circle *c, const char * const *ident, uint32_t key)
+{
+	unsigned idx;
+
+	idx = shard_layout_lookup(c->layout, c->points, c->n_points, c->lut,
+	    c->shift, key);
+	return (ident[c->points[idx].host]);
+}
+
+/* Fraction of keys whose backend differs between two circles */
+static double
+moved(const struct circle *a, const char * const *ia,
+    const struct circle *b, const char * const *ib,
+    const uint32_t *keys, unsigned nkeys)
+{
+	unsigned i, m = 0;
+
+	for (i = 0; i < nkeys; i++)
+		if (lookup(a, ia, keys[i]) != lookup(b, ib, keys[i]))
+			m++;
+	return ((double)m / nkeys);
+}
+
+static void
+bench(enum layout_e layout, const char *name, char **names, unsigned n,
+    unsigned replicas, const uint32_t *keys, unsigned nkeys)
+{
+	const char *ident[n + 1], *less[n];
+	struct circle c, c2;
+	unsigned *cnt, i, idx, sum = 0, hi = 0, lo = UINT_MAX;
+	double t_build, t_lookup, add, rem;
+
+	for (i = 0; i <= n; i++)
+		ident[i] = names[i];
+
+	t_build = now();
+	build(&c, layout, ident, n, replicas);
+	t_build = now() - t_build;
+
+	t_lookup = now();
+	for (i = 0; i < nkeys; i++)
+		sum += shard_layout_lookup(layout, c.points, c.n_points, c.lut,
+		    c.shift, keys[i]);
+	t_lookup = now() - t_lookup;
+	if (sum == 1)		/* Don't let the compiler skip the work */
+		printf(" ");
+
+	cnt = calloc(n, sizeof *cnt);
+	AN(cnt);
+	for (i = 0; i < nkeys; i++) {
+		idx = shard_layout_lookup(layout, c.points, c.n_points, c.lut,
+		    c.shift, keys[i]);
+		cnt[c.points[idx].host]++;
+	}
+	for (i = 0; i < n; i++) {
+		if (cnt[i] > hi)
+			hi = cnt[i];
+		if (cnt[i] < lo)
+			lo = cnt[i];
+	}
+	free(cnt);
+
+	/* One more backend at the end */
+	build(&c2, layout, ident, n + 1, replicas);
+	add = moved(&c, ident, &c2, ident, keys, nkeys);
+	destroy(&c2);
+
+	/* The director fills the hole of a removed backend with its last */
+	for (i = 0; i < n; i++)
+		less[i] = ident[i];
+	less[n / 2] = ident[n - 1];
+	build(&c2, layout, less, n - 1, replicas);
+	rem = moved(&c, ident, &c2, less, keys, nkeys);
+	destroy(&c2);
+
+	printf("%-8s %8u %9u %9.2f %9.1f %7.1f%% %7.1f%% "
+	    "%6.2f%% %6.2f%% %6.2f%% %6.2f%%\n",
+	    name, n, c.n_points, t_build * 1e3, t_lookup * 1e9 / nkeys,
+	    100. * hi * n / nkeys - 100., 100. * lo * n / nkeys - 100.,
+	    100. * add, 100. / (n + 1), 100. * rem, 100. / n);
+	destroy(&c);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+	    "Usage: shard_bench [-r replicas] [-k keys] [backends ...]\n");
+	exit(2);
+}
+
+int
+main(int argc, char * const *argv)
+{
+	static const unsigned dflt[] = { 10, 100, 500 };
+	unsigned replicas = 67, nkeys = 1000000, *nb, nnb, max, i, l;
+	uint32_t *keys, x = 2463534242U;
+	char **names;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "k:r:")) != -1) {
+		switch (ch) {
+		case 'k':
+			nkeys = strtoul(optarg, NULL, 0);
+			if (nkeys < 1)
+				usage();
+			break;
+		case 'r':
+			replicas = strtoul(optarg, NULL, 0);
+			if (replicas < 1)
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc > 0) {
+		nnb = argc;
+		nb = calloc(nnb, sizeof *nb);
+		AN(nb);
+		for (i = 0; i < nnb; i++) {
+			nb[i] = strtoul(argv[i], NULL, 0);
+			if (nb[i] < 2)
+				usage();
+		}
+	} else {
+		nnb = sizeof dflt / sizeof dflt[0];
+		nb = TRUST_ME(dflt);
+	}
+
+	for (max = i = 0; i < nnb; i++)
+		if (nb[i] > max)
+			max = nb[i];
+	names = calloc(max + 1, sizeof *names);
+	AN(names);
+	for (i = 0; i <= max; i++)
+		AN(asprintf(&names[i], "backend%u", i) > 0);
+
+	/* xorshift32, so every run looks up the same keys */
+	keys = calloc(nkeys, sizeof *keys);
+	AN(keys);
+	for (i = 0; i < nkeys; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		keys[i] = x;
+	}
+
+	printf("replicas %u, %u keys\n", replicas, nkeys);
+	printf("%-8s %8s %9s %9s %9s %8s %8s %7s %7s %7s %7s\n",
+	    "layout", "backends", "points", "build ms", "lookup ns",
+	    "max", "min", "add", "ideal", "remove", "ideal");
+	for (i = 0; i < nnb; i++)
+		for (l = 0; l < sizeof layouts / sizeof layouts[0]; l++)
+			bench(layouts[l].layout, layouts[l].name, names,
+			    nb[i], replicas, keys, nkeys);
+	return (0);
+}
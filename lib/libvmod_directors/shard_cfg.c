@@ -36,10 +36,12 @@
 #include "cache/cache_director.h"
 
 #include "vrt.h"
+#include "vcl.h"
 
 #include "shard_dir.h"
 #include "shard_cfg.h"
 #include "shard_hash.h"
+#include "vdir.h"
 
 /*lint -esym(749,  shard_change_task_e::*) */
 enum shard_change_task_e {
@@ -222,71 +224,99 @@ shardcfg_clear(VRT_CTX, struct vmod_priv *priv, const struct sharddir *shardd)
  * consistent hashing cirle init
  */
 
-typedef int (*compar)( const void*, const void* );
-
-static int
-circlepoint_compare(const struct shard_circlepoint *a,
-    const struct shard_circlepoint *b)
+static void
+shardcfg_circle_free(struct shard_circle *circle)
 {
-	return (a->point == b->point) ? 0 : ((a->point > b->point) ? 1 : -1);
+
+	CHECK_OBJ_NOTNULL(circle, SHARD_CIRCLE_MAGIC);
+	free(circle->backend);
+	free(circle->points);
+	free(circle->lut);
+	FREE_OBJ(circle);
 }
 
-static void
-shardcfg_hashcircle(struct sharddir *shardd, VCL_INT replicas, enum alg_e alg)
+static struct shard_circle *
+shardcfg_hashcircle(struct sharddir *shardd, VCL_INT replicas, enum alg_e alg,
+    enum layout_e layout)
 {
-	int i, j;
-	const char *ident;
-	int len;
+	struct shard_circle *circle;
+	int i;
 
 	CHECK_OBJ_NOTNULL(shardd, SHARDDIR_MAGIC);
-	AZ(shardd->hashcircle);
 
 	assert(shardd->n_backend > 0);
 	AN(shardd->backend);
 
-	shardd->hashcircle = calloc(shardd->n_backend * replicas,
-		sizeof(struct shard_circlepoint));
-	AN(shardd->hashcircle);
+	ALLOC_OBJ(circle, SHARD_CIRCLE_MAGIC);
+	AN(circle);
 
-	shardd->replicas = replicas;
+	/* The identities belong to the configuration, we need none */
+	circle->n_backend = shardd->n_backend;
+	circle->backend = calloc(circle->n_backend, sizeof *circle->backend);
+	AN(circle->backend);
+
+	const char *ident[shardd->n_backend];
 
 	for (i = 0; i < shardd->n_backend; i++) {
 		CHECK_OBJ_NOTNULL(shardd->backend[i].backend, DIRECTOR_MAGIC);
+		circle->backend[i].backend = shardd->backend[i].backend;
+		circle->backend[i].rampup = shardd->backend[i].rampup;
 
-		ident = shardd->backend[i].ident
+		ident[i] = shardd->backend[i].ident
 		    ? shardd->backend[i].ident
 		    : shardd->backend[i].backend->vcl_name;
 
-		assert(ident[0] != '\0');
-
-		len = strlen(ident) + 12; // log10(UINT32_MAX) + 2;
+		assert(ident[i][0] != '\0');
+	}
 
-		char s[len];
+	shardd->replicas = replicas;
 
-		for (j = 0; j < replicas; j++) {
-			assert(snprintf(s, len, "%s%d", ident, j) < len);
-			shardd->hashcircle[i * replicas + j].point =
-			    shard_hash_f[alg](s);
-			shardd->hashcircle[i * replicas + j].host = i;
-		}
-		/* not used in current interface */
-		shardd->backend[i].canon_point =
-		    shardd->hashcircle[i * replicas].point;
-	}
-	qsort( (void *) shardd->hashcircle, shardd->n_backend * replicas,
-	    sizeof (struct shard_circlepoint), (compar) circlepoint_compare);
+	circle->layout = layout;
+	circle->points = shard_layout(layout, ident, shardd->n_backend,
+	    replicas, shard_hash_f[alg], &circle->n_points);
+	if (layout == RING)
+		circle->lut = shard_layout_lut(circle->points,
+		    circle->n_points, &circle->lut_shift);
 
 	if ((shardd->debug_flags & SHDBG_CIRCLE) == 0)
-		return;
+		return (circle);
+
+	for (i = 0; i < circle->n_points; i++)
+		SHDBG(SHDBG_CIRCLE, shardd,
+		    "hashcircle[%5d] = "
+		    "{point = %8x, host = %2u}\n",
+		    i, circle->points[i].point, circle->points[i].host);
+	return (circle);
+}
 
-	for (i = 0; i < shardd->n_backend; i++)
-		for (j = 0; j < replicas; j++)
-			SHDBG(SHDBG_CIRCLE, shardd,
-			    "hashcircle[%5ld] = "
-			    "{point = %8x, host = %2u}\n",
-			    i * replicas + j,
-			    shardd->hashcircle[i * replicas + j].point,
-			    shardd->hashcircle[i * replicas + j].host);
+/*
+ * Replace the circle which requests use.  Lookups may still be walking
+ * the old one, so it is handed to vdir_retire() to be freed once they
+ * are done with it.
+ */
+
+static void
+shardcfg_circle_retired(void *priv)
+{
+
+	shardcfg_circle_free(priv);
+}
+
+static void
+shardcfg_publish(VRT_CTX, struct sharddir *shardd,
+    struct shard_circle *circle)
+{
+	struct shard_circle *old;
+
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	CHECK_OBJ_NOTNULL(shardd, SHARDDIR_MAGIC);
+	CHECK_OBJ_ORNULL(circle, SHARD_CIRCLE_MAGIC);
+
+	old = shardd->circle;
+	__sync_synchronize();	/* Lookups take no lock */
+	shardd->circle = circle;
+	if (old != NULL)
+		vdir_retire(ctx, old, shardcfg_circle_retired);
 }
 
 /*
@@ -574,7 +604,8 @@ shardcfg_apply_change(VRT_CTX, struct sharddir *shardd,
 
 VCL_BOOL
 shardcfg_reconfigure(VRT_CTX, struct vmod_priv *priv,
-    struct sharddir *shardd, VCL_INT replicas, enum alg_e alg)
+    struct sharddir *shardd, VCL_INT replicas, enum alg_e alg,
+    enum layout_e layout)
 {
 	struct shard_change *change;
 
@@ -597,17 +628,22 @@ shardcfg_reconfigure(VRT_CTX, struct vmod_priv *priv,
 	shardcfg_apply_change(ctx, shardd, change);
 	shard_change_finish(change);
 
-	if (shardd->hashcircle)
-		free(shardd->hashcircle);
-	shardd->hashcircle = NULL;
-
 	if (shardd->n_backend == 0) {
+		shardcfg_publish(ctx, shardd, NULL);
 		shard_err0(ctx, shardd, ".reconfigure() no backends");
 		sharddir_unlock(shardd);
 		return 0;
 	}
 
-	shardcfg_hashcircle(shardd, replicas, alg);
+	if (replicas > INT_MAX / shardd->n_backend) {
+		shard_err(ctx, shardd,
+		    ".reconfigure() replicas argument %ld too large", replicas);
+		sharddir_unlock(shardd);
+		return 0;
+	}
+
+	shardcfg_publish(ctx, shardd,
+	    shardcfg_hashcircle(shardd, replicas, alg, layout));
 	sharddir_unlock(shardd);
 	return (1);
 }
@@ -627,8 +663,8 @@ shardcfg_delete(const struct sharddir *shardd)
 		shardcfg_backend_free(&shardd->backend[i]);
 	if (shardd->backend)
 		free(shardd->backend);
-	if (shardd->hashcircle)
-		free(shardd->hashcircle);
+	if (shardd->circle)
+		shardcfg_circle_free(shardd->circle);
 }
 
 VCL_VOID
@@ -652,19 +688,20 @@ shardcfg_set_rampup(struct sharddir *shardd, VCL_DURATION duration)
 }
 
 VCL_DURATION
-shardcfg_get_rampup(const struct sharddir *shardd, int host)
+shardcfg_get_rampup(const struct sharddir *shardd,
+    const struct shard_circle *circle, int host)
 {
 	VCL_DURATION r;
 
 	CHECK_OBJ_NOTNULL(shardd, SHARDDIR_MAGIC);
-	// assert sharddir_rdlock_held(shardd);
-	assert (host < shardd->n_backend);
+	CHECK_OBJ_NOTNULL(circle, SHARD_CIRCLE_MAGIC);
+	assert (host < circle->n_backend);
 
 	// magic value for default
-	if (shardd->backend[host].rampup == 973279260)
+	if (circle->backend[host].rampup == 973279260)
 		r = shardd->rampup_duration;
 	else
-		r = shardd->backend[host].rampup;
+		r = circle->backend[host].rampup;
 
 	return (r);
 }
@@ -59,6 +59,7 @@ struct shard_be_info {
 struct shard_state {
 	const struct vrt_ctx	*ctx;
 	struct sharddir	*shardd;
+	const struct shard_circle	*circle;
 	int			idx;
 
 	struct vbitmap		*picklist;
@@ -89,32 +90,12 @@ sharddir_err(VRT_CTX, enum VSL_tag_e tag,  const char *fmt, ...)
 }
 
 static int
-shard_lookup(const struct sharddir *shardd, const uint32_t key)
+shard_lookup(const struct shard_circle *circle, const uint32_t key)
 {
-	CHECK_OBJ_NOTNULL(shardd, SHARDDIR_MAGIC);
 
-	const int n = shardd->n_backend * shardd->replicas;
-	int idx = -1, high = n, low = 0, i;
-
-	do {
-	    i = (high + low) / 2 ;
-	    if (shardd->hashcircle[i].point == key)
-		idx = i;
-	    else if (i == n - 1)
-		idx = n - 1;
-	    else if (shardd->hashcircle[i].point < key &&
-		     shardd->hashcircle[i+1].point >= key)
-		idx = i + 1;
-	    else if (shardd->hashcircle[i].point > key)
-		if (i == 0)
-		    idx = 0;
-		else
-		    high = i;
-	    else
-		low = i;
-	} while (idx == -1);
-
-	return idx;
+	CHECK_OBJ_NOTNULL(circle, SHARD_CIRCLE_MAGIC);
+	return (shard_layout_lookup(circle->layout, circle->points,
+	    circle->n_points, circle->lut, circle->lut_shift, key));
 }
 
 static int
@@ -128,16 +109,16 @@ shard_next(struct shard_state *state, VCL_INT skip, VCL_BOOL healthy)
 
 	AN(state);
 	assert(state->idx >= 0);
-	CHECK_OBJ_NOTNULL(state->shardd, SHARDDIR_MAGIC);
+	CHECK_OBJ_NOTNULL(state->circle, SHARD_CIRCLE_MAGIC);
 
-	if (state->pickcount >= state->shardd->n_backend)
+	if (state->pickcount >= state->circle->n_backend)
 		return -1;
 
-	ringsz = state->shardd->n_backend * state->shardd->replicas;
+	ringsz = state->circle->n_points;
 
-	while (state->pickcount < state->shardd->n_backend && skip >= 0) {
+	while (state->pickcount < state->circle->n_backend && skip >= 0) {
 
-		c = state->shardd->hashcircle[state->idx].host;
+		c = state->circle->points[state->idx].host;
 
 		if (!vbit_test(state->picklist, c)) {
 
@@ -145,7 +126,7 @@ shard_next(struct shard_state *state, VCL_INT skip, VCL_BOOL healthy)
 			state->pickcount++;
 
 			sbe = NULL;
-			be = state->shardd->backend[c].backend;
+			be = state->circle->backend[c].backend;
 			AN(be);
 			if (be->healthy(be, state->ctx->bo, &changed)) {
 				if (skip-- == 0) {
@@ -209,13 +190,6 @@ sharddir_delete(struct sharddir **sharddp)
 	FREE_OBJ(shardd);
 }
 
-void
-sharddir_rdlock(struct sharddir *shardd)
-{
-	CHECK_OBJ_NOTNULL(shardd, SHARDDIR_MAGIC);
-	AZ(pthread_rwlock_rdlock(&shardd->mtx));
-}
-
 void
 sharddir_wrlock(struct sharddir *shardd)
 {
@@ -231,9 +205,10 @@ sharddir_unlock(struct sharddir *shardd)
 }
 
 static inline void
-validate_alt(VRT_CTX, const struct sharddir *shardd, VCL_INT *alt)
+validate_alt(VRT_CTX, const struct sharddir *shardd,
+    const struct shard_circle *circle, VCL_INT *alt)
 {
-	const VCL_INT alt_max = shardd->n_backend - 1;
+	const VCL_INT alt_max = circle->n_backend - 1;
 
 	if (*alt < 0) {
 		shard_err(ctx, shardd,
@@ -247,13 +222,14 @@ validate_alt(VRT_CTX, const struct sharddir *shardd, VCL_INT *alt)
 }
 
 static inline void
-init_state(struct shard_state *state,
-    VRT_CTX, struct sharddir *shardd, struct vbitmap *picklist)
+init_state(struct shard_state *state, VRT_CTX, struct sharddir *shardd,
+    const struct shard_circle *circle, struct vbitmap *picklist)
 {
 	AN(picklist);
 
 	state->ctx = ctx;
 	state->shardd = shardd;
+	state->circle = circle;
 	state->idx = -1;
 	state->picklist = picklist;
 
@@ -262,66 +238,33 @@ init_state(struct shard_state *state,
 	state->last.hostid = -1;
 }
 
-/*
- * core function for the director backend method
- *
- * while other directors return a reference to their own backend object (on
- * which varnish will call the resolve method to resolve to a non-director
- * backend), this director immediately reolves in the backend method, to make
- * the director choice visible in VCL
- *
- * consequences:
- * - we need no own struct director
- * - we can only respect a busy object when being called on the backend side,
- *   which probably is, for all practical purposes, only relevant when the
- *   saintmode vmod is used
- *
- * if we wanted to offer delayed resolution, we'd need something like
- * per-request per-director state or we'd need to return a dynamically created
- * director object. That should be straight forward once we got director
- * refcounting #2072. Until then, we could create it on the workspace, but then
- * we'd need to keep other directors from storing any references to our dynamic
- * object for longer than the current task
- *
- */
-VCL_BACKEND
-sharddir_pick_be(VRT_CTX, struct sharddir *shardd,
-    uint32_t key, VCL_INT alt, VCL_REAL warmup, VCL_BOOL rampup,
-    enum healthy_e healthy)
+static VCL_BACKEND
+sharddir_pick_circle(VRT_CTX, struct sharddir *shardd,
+    const struct shard_circle *circle, uint32_t key, VCL_INT alt,
+    VCL_REAL warmup, VCL_BOOL rampup, enum healthy_e healthy)
 {
 	VCL_BACKEND be;
 	struct shard_state state;
-	unsigned picklist_sz = VBITMAP_SZ(shardd->n_backend);
-	char picklist_spc[picklist_sz];
 	VCL_DURATION chosen_r, alt_r;
-
-	CHECK_OBJ_NOTNULL(shardd, SHARDDIR_MAGIC);
-	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
-	AN(ctx->vsl);
+	unsigned picklist_sz = VBITMAP_SZ(circle->n_backend);
+	char picklist_spc[picklist_sz];
 
 	memset(&state, 0, sizeof(state));
-	init_state(&state, ctx, shardd, vbit_init(picklist_spc, picklist_sz));
-
-	sharddir_rdlock(shardd);
-	if (shardd->n_backend == 0) {
-		shard_err0(ctx, shardd, "no backends");
-		goto err;
-	}
-
-	assert(shardd->hashcircle);
+	init_state(&state, ctx, shardd, circle,
+	    vbit_init(picklist_spc, picklist_sz));
 
-	validate_alt(ctx, shardd, &alt);
+	validate_alt(ctx, shardd, circle, &alt);
 
-	state.idx = shard_lookup(shardd, key);
+	state.idx = shard_lookup(circle, key);
 	assert(state.idx >= 0);
 
 	SHDBG(SHDBG_LOOKUP, shardd, "lookup key %x idx %d host %u",
-	    key, state.idx, shardd->hashcircle[state.idx].host);
+	    key, state.idx, circle->points[state.idx].host);
 
 	if (alt > 0) {
 		if (shard_next(&state, alt - 1, healthy == ALL ? 1 : 0) == -1) {
 			if (state.previous.hostid != -1) {
-				be = sharddir_backend(shardd,
+				be = sharddir_backend(circle,
 				    state.previous.hostid);
 				goto ok;
 			}
@@ -331,13 +274,13 @@ sharddir_pick_be(VRT_CTX, struct sharddir *shardd,
 
 	if (shard_next(&state, 0, healthy == IGNORE ? 0 : 1) == -1) {
 		if (state.previous.hostid != -1) {
-			be = sharddir_backend(shardd, state.previous.hostid);
+			be = sharddir_backend(circle, state.previous.hostid);
 			goto ok;
 		}
 		goto err;
 	}
 
-	be = sharddir_backend(shardd, state.last.hostid);
+	be = sharddir_backend(circle, state.last.hostid);
 
 	if (warmup == -1)
 		warmup = shardd->warmup;
@@ -351,10 +294,10 @@ sharddir_pick_be(VRT_CTX, struct sharddir *shardd,
 	assert(state.previous.hostid >= 0);
 	assert(state.last.hostid >= 0);
 	assert(state.previous.hostid != state.last.hostid);
-	assert(be == sharddir_backend(shardd, state.previous.hostid));
+	assert(be == sharddir_backend(circle, state.previous.hostid));
 
-	chosen_r = shardcfg_get_rampup(shardd, state.previous.hostid);
-	alt_r = shardcfg_get_rampup(shardd, state.last.hostid);
+	chosen_r = shardcfg_get_rampup(shardd, circle, state.previous.hostid);
+	alt_r = shardcfg_get_rampup(shardd, circle, state.last.hostid);
 
 	SHDBG(SHDBG_RAMPWARM, shardd, "chosen host %d rampup %f changed %f",
 	    state.previous.hostid, chosen_r,
@@ -380,15 +323,58 @@ sharddir_pick_be(VRT_CTX, struct sharddir *shardd,
 			goto ok;
 	}
 
-	be = sharddir_backend(shardd, state.last.hostid);
+	be = sharddir_backend(circle, state.last.hostid);
 
   ok:
 	AN(be);
-	sharddir_unlock(shardd);
 	vbit_destroy(state.picklist);
 	return (be);
   err:
-	sharddir_unlock(shardd);
 	vbit_destroy(state.picklist);
 	return NULL;
 }
+
+/*
+ * core function for the director backend method
+ *
+ * while other directors return a reference to their own backend object (on
+ * which varnish will call the resolve method to resolve to a non-director
+ * backend), this director immediately reolves in the backend method, to make
+ * the director choice visible in VCL
+ *
+ * consequences:
+ * - we need no own struct director
+ * - we can only respect a busy object when being called on the backend side,
+ *   which probably is, for all practical purposes, only relevant when the
+ *   saintmode vmod is used
+ *
+ * if we wanted to offer delayed resolution, we'd need something like
+ * per-request per-director state or we'd need to return a dynamically created
+ * director object. That should be straight forward once we got director
+ * refcounting #2072. Until then, we could create it on the workspace, but then
+ * we'd need to keep other directors from storing any references to our dynamic
+ * object for longer than the current task
+ *
+ */
+VCL_BACKEND
+sharddir_pick_be(VRT_CTX, struct sharddir *shardd,
+    uint32_t key, VCL_INT alt, VCL_REAL warmup, VCL_BOOL rampup,
+    enum healthy_e healthy)
+{
+	const struct shard_circle *circle;
+
+	CHECK_OBJ_NOTNULL(shardd, SHARDDIR_MAGIC);
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	AN(ctx->vsl);
+
+	circle = shardd->circle;
+	if (circle == NULL) {
+		shard_err0(ctx, shardd, "no backends");
+		return (NULL);
+	}
+	CHECK_OBJ(circle, SHARD_CIRCLE_MAGIC);
+	assert(circle->n_backend > 0);
+
+	return (sharddir_pick_circle(ctx, shardd, circle, key, alt, warmup,
+	    rampup, healthy));
+}
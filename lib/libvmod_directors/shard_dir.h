@@ -28,14 +28,10 @@
  */
 
 #include "shard_parse_vcc_enums.h"
+#include "shard_layout.h"
 
 struct vbitmap;
 
-struct shard_circlepoint {
-	uint32_t		point;
-	unsigned int		host;
-};
-
 struct shard_backend {
 	VCL_BACKEND		backend;
 	const char		*ident;	// XXX COPY IN !
@@ -43,6 +39,30 @@ struct shard_backend {
 	uint32_t		canon_point;
 };
 
+/*
+ * What the request side needs of the configuration, as of the last
+ * reconfigure().  It is never changed once published, so lookups take
+ * no lock: a new circle replaces the old one, which is kept around
+ * until no request can be using it anymore.
+ *
+ * For the RING layout, lut[key >> lut_shift] is the first index with a
+ * point not below the smallest key in that bucket.
+ */
+struct shard_circle {
+	unsigned				magic;
+#define SHARD_CIRCLE_MAGIC			0x2fc4e2c5
+
+	unsigned				n_backend;
+	struct shard_backend			*backend;
+
+	enum layout_e				layout;
+	unsigned				n_points;
+	struct shard_circlepoint		*points;
+
+	unsigned				lut_shift;
+	unsigned				*lut;
+};
+
 #define	SHDBG_LOOKUP	 1
 #define	SHDBG_CIRCLE	(1<<1)
 #define	SHDBG_RAMPWARM	(1<<2)
@@ -60,7 +80,7 @@ struct sharddir {
 	unsigned				l_backend;
 	struct shard_backend			*backend;
 
-	struct shard_circlepoint		*hashcircle;
+	struct shard_circle			*circle;
 
 	VCL_DURATION				rampup_duration;
 	VCL_REAL				warmup;
@@ -68,11 +88,11 @@ struct sharddir {
 };
 
 static inline VCL_BACKEND
-sharddir_backend(const struct sharddir *shardd, int id)
+sharddir_backend(const struct shard_circle *circle, int id)
 {
 	assert(id >= 0);
-	assert(id < shardd->n_backend);
-	return (shardd->backend[id].backend);
+	assert(id < circle->n_backend);
+	return (circle->backend[id].backend);
 }
 
 static inline const char *
@@ -105,7 +125,6 @@ void sharddir_debug(struct sharddir *shardd, const uint32_t flags);
 void sharddir_err(VRT_CTX, enum VSL_tag_e tag,  const char *fmt, ...);
 void sharddir_new(struct sharddir **sharddp, const char *vcl_name);
 void sharddir_delete(struct sharddir **sharddp);
-void sharddir_rdlock(struct sharddir *shardd);
 void sharddir_wrlock(struct sharddir *shardd);
 void sharddir_unlock(struct sharddir *shardd);
 VCL_BACKEND sharddir_pick_be(VRT_CTX, struct sharddir *, uint32_t, VCL_INT,
@@ -113,4 +132,5 @@ VCL_BACKEND sharddir_pick_be(VRT_CTX, struct sharddir *, uint32_t, VCL_INT,
 
 /* in shard_cfg.c */
 void shardcfg_delete(const struct sharddir *shardd);
-VCL_DURATION shardcfg_get_rampup(const struct sharddir *shardd, int host);
+VCL_DURATION shardcfg_get_rampup(const struct sharddir *shardd,
+    const struct shard_circle *circle, int host);
@@ -0,0 +1,312 @@
+/*-
+ * Copyright (c) 2017 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * See shard_layout.h
+ */
+
+#include "config.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vdef.h"
+#include "vas.h"
+
+#include "shard_parse_vcc_enums.h"
+#include "shard_layout.h"
+
+typedef int (*compar)( const void*, const void* );
+
+static int
+circlepoint_compare(const struct shard_circlepoint *a,
+    const struct shard_circlepoint *b)
+{
+	return (a->point == b->point) ? 0 : ((a->point > b->point) ? 1 : -1);
+}
+
+/*--------------------------------------------------------------------
+ * Ring
+ */
+
+static struct shard_circlepoint *
+shard_layout_ring(const char * const *ident, unsigned n_backend,
+    unsigned replicas, shard_layout_hash_f *hash, unsigned *n_points)
+{
+	struct shard_circlepoint *points;
+	unsigned i, j;
+	size_t len;
+
+	points = calloc((size_t)n_backend * replicas, sizeof *points);
+	AN(points);
+
+	for (i = 0; i < n_backend; i++) {
+		len = strlen(ident[i]) + 12; // log10(UINT32_MAX) + 2;
+
+		char s[len];
+
+		for (j = 0; j < replicas; j++) {
+			assert(snprintf(s, len, "%s%d", ident[i], j) < len);
+			points[i * replicas + j].point = hash(s);
+			points[i * replicas + j].host = i;
+		}
+	}
+	*n_points = n_backend * replicas;
+	qsort( (void *) points, *n_points,
+	    sizeof (struct shard_circlepoint), (compar) circlepoint_compare);
+	return (points);
+}
+
+/*
+ * About one bucket per point, but no more than 64K of them
+ */
+
+unsigned *
+shard_layout_lut(const struct shard_circlepoint *points, unsigned n_points,
+    unsigned *shift)
+{
+	unsigned bits, b, i, *lut;
+
+	for (bits = 1; bits < 16 && (1U << bits) < n_points; bits++)
+		continue;
+	*shift = 32 - bits;
+	lut = calloc(1U << bits, sizeof *lut);
+	AN(lut);
+
+	for (b = i = 0; b < (1U << bits); b++) {
+		while (i < n_points &&
+		    points[i].point < ((uint32_t)b << *shift))
+			i++;
+		lut[b] = i;
+	}
+	return (lut);
+}
+
+/*
+ * The table narrows the search down to the points in the key's bucket,
+ * of which there are about one on average.
+ *
+ * We return what the binary search which used to be here did, lest
+ * keys move to other backends: keys beyond the last point map to it,
+ * rather than wrapping around, and so do all keys on a circle of two.
+ */
+
+static unsigned
+shard_layout_ring_lookup(const struct shard_circlepoint *points, unsigned n,
+    const unsigned *lut, unsigned shift, uint32_t key)
+{
+	unsigned idx;
+
+	if (n <= 2 || points[n - 1].point < key)
+		return (n - 1);
+
+	AN(lut);
+	idx = lut[key >> shift];
+	while (points[idx].point < key)
+		idx++;
+	assert(idx < n);
+	return (idx);
+}
+
+/*--------------------------------------------------------------------
+ * Maglev: Eisenbud et al., "Maglev: A Fast and Reliable Software Network
+ * Load Balancer", NSDI 2016, section 3.4.
+ *
+ * Each backend gets every slot in a permutation of the table, given by
+ * an offset and a skip, unless it is taken, in turns, until the table
+ * is full.  The table size being prime, every skip cycles through all
+ * of it, and the backends end up with the same number of slots, give
+ * or take one.
+ *
+ * Keys land on slots by their remainder, so the table size must not
+ * change with every backend change: it is the first prime above the
+ * power of two which fits replicas slots per backend.
+ */
+
+static unsigned
+shard_layout_prime(unsigned n)
+{
+	unsigned d;
+
+	if (n < 3)
+		return (3);
+	for (n |= 1; ; n += 2) {
+		for (d = 3; d * d <= n; d += 2)
+			if (n % d == 0)
+				break;
+		if (d * d > n)
+			return (n);
+	}
+}
+
+static struct shard_circlepoint *
+shard_layout_maglev(const char * const *ident, unsigned n_backend,
+    unsigned replicas, shard_layout_hash_f *hash, unsigned *n_points)
+{
+	struct shard_circlepoint *points;
+	uint32_t *offset, *skip, *next;
+	unsigned i, m, c, filled;
+	size_t len;
+
+	assert(replicas <= INT_MAX / n_backend);
+	for (m = 256; m < n_backend * replicas; m <<= 1)
+		continue;
+	m = shard_layout_prime(m);
+
+	points = malloc(m * sizeof *points);
+	offset = calloc(n_backend, sizeof *offset);
+	skip = calloc(n_backend, sizeof *skip);
+	next = calloc(n_backend, sizeof *next);
+	AN(points);
+	AN(offset);
+	AN(skip);
+	AN(next);
+
+	for (i = 0; i < n_backend; i++) {
+		len = strlen(ident[i]) + 2;
+
+		char s[len];
+
+		assert(snprintf(s, len, "%s0", ident[i]) < len);
+		offset[i] = hash(s) % m;
+		assert(snprintf(s, len, "%s1", ident[i]) < len);
+		skip[i] = hash(s) % (m - 1) + 1;
+	}
+
+	for (c = 0; c < m; c++) {
+		points[c].point = c;
+		points[c].host = UINT_MAX;
+	}
+
+	filled = 0;
+	while (filled < m) {
+		for (i = 0; i < n_backend && filled < m; i++) {
+			do {
+				c = (offset[i] +
+				    (uint64_t)next[i]++ * skip[i]) % m;
+			} while (points[c].host != UINT_MAX);
+			points[c].host = i;
+			filled++;
+		}
+	}
+
+	free(offset);
+	free(skip);
+	free(next);
+	*n_points = m;
+	return (points);
+}
+
+/*--------------------------------------------------------------------
+ * Jump: Lamping & Veach, "A Fast, Minimal Memory, Consistent Hash
+ * Algorithm", 2014.  Only adding or removing the last backend moves
+ * no more keys than it has to.  The director fills the hole a removed
+ * backend leaves with its last one, which then moves keys of both.
+ */
+
+static unsigned
+shard_layout_jump(uint64_t key, unsigned n)
+{
+	int64_t b = -1, j = 0;
+
+	while (j < n) {
+		b = j;
+		key = key * 2862933555777941757ULL + 1;
+		j = (int64_t)((b + 1) *
+		    ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+	}
+	assert(b >= 0 && b < n);
+	return ((unsigned)b);
+}
+
+static struct shard_circlepoint *
+shard_layout_linear(unsigned n_backend, unsigned *n_points)
+{
+	struct shard_circlepoint *points;
+	unsigned i;
+
+	points = calloc(n_backend, sizeof *points);
+	AN(points);
+	for (i = 0; i < n_backend; i++) {
+		points[i].point = i;
+		points[i].host = i;
+	}
+	*n_points = n_backend;
+	return (points);
+}
+
+/*--------------------------------------------------------------------*/
+
+struct shard_circlepoint *
+shard_layout(enum layout_e layout, const char * const *ident,
+    unsigned n_backend, unsigned replicas, shard_layout_hash_f *hash,
+    unsigned *n_points)
+{
+
+	AN(ident);
+	AN(hash);
+	AN(n_points);
+	assert(n_backend > 0);
+	assert(replicas > 0);
+
+	switch (layout) {
+	case RING:
+		return (shard_layout_ring(ident, n_backend, replicas, hash,
+		    n_points));
+	case MAGLEV:
+		return (shard_layout_maglev(ident, n_backend, replicas, hash,
+		    n_points));
+	case JUMP:
+		return (shard_layout_linear(n_backend, n_points));
+	default:
+		WRONG("invalid shard layout");
+	}
+	NEEDLESS(return (NULL));
+}
+
+unsigned
+shard_layout_lookup(enum layout_e layout,
+    const struct shard_circlepoint *points, unsigned n_points,
+    const unsigned *lut, unsigned shift, uint32_t key)
+{
+
+	AN(points);
+	assert(n_points > 0);
+
+	switch (layout) {
+	case RING:
+		return (shard_layout_ring_lookup(points, n_points, lut, shift,
+		    key));
+	case MAGLEV:
+		return (key % n_points);
+	case JUMP:
+		return (shard_layout_jump(key, n_points));
+	default:
+		WRONG("invalid shard layout");
+	}
+	NEEDLESS(return (0));
+}
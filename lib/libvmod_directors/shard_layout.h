@@ -0,0 +1,58 @@
+/*-
+ * Copyright (c) 2017 Varnish Software AS
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Placement of backends on the shard director's circle
+ *
+ * All layouts come down to an array of points, each naming a backend,
+ * which is walked forward from where a key lands to find alternative
+ * backends:
+ *
+ * RING		replicas hashed points per backend, sorted.  A key lands
+ *		on the first point not below it.
+ * MAGLEV	a table of at least replicas slots per backend, filled
+ *		from per backend permutations as in Google's Maglev.  A
+ *		key lands on slot key % size.
+ * JUMP		one point per backend, in the order of the director's
+ *		backends, and a key lands on the one jump consistent
+ *		hashing picks.
+ *
+ * Nothing in here depends on varnishd, so that shard_bench can use it.
+ */
+
+struct shard_circlepoint {
+	uint32_t		point;
+	unsigned int		host;
+};
+
+typedef uint32_t shard_layout_hash_f(const char *);
+
+struct shard_circlepoint *shard_layout(enum layout_e layout,
+    const char * const *ident, unsigned n_backend, unsigned replicas,
+    shard_layout_hash_f *hash, unsigned *n_points);
+unsigned *shard_layout_lut(const struct shard_circlepoint *points,
+    unsigned n_points, unsigned *shift);
+unsigned shard_layout_lookup(enum layout_e layout,
+    const struct shard_circlepoint *points, unsigned n_points,
+    const unsigned *lut, unsigned shift, uint32_t key);
@@ -130,3 +130,40 @@ enum healthy_e parse_healthy_e (const char *m) {
   invalid:
     return _HEALTHY_E_INVALID;
 }
+
+
+enum layout_e parse_layout_e (const char *m) {
+	enum layout_e r;
+
+	switch (m[0]) {
+	case 'J':	goto _0J;	// JUMP
+	case 'M':	goto _0M;	// MAGLEV
+	case 'R':	goto _0R;	// RING
+	default:	goto invalid;
+	}
+	 _0J:
+	//JUMP
+	if ((m[1] == 'U') && (m[2] == 'M') && (m[3] == 'P') && (term(m[4]))) {
+	    r = JUMP;
+	    goto ok;
+	}
+	goto invalid;
+	 _0M:
+	//MAGLEV
+	if ((m[1] == 'A') && (m[2] == 'G') && (m[3] == 'L') && (m[4] == 'E') && (m[5] == 'V') && (term(m[6]))) {
+	    r = MAGLEV;
+	    goto ok;
+	}
+	goto invalid;
+	 _0R:
+	//RING
+	if ((m[1] == 'I') && (m[2] == 'N') && (m[3] == 'G') && (term(m[4]))) {
+	    r = RING;
+	    goto ok;
+	}
+	goto invalid;
+  ok:
+	return r;
+  invalid:
+    return _LAYOUT_E_INVALID;
+}
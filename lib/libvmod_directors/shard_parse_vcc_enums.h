@@ -43,3 +43,16 @@ enum healthy_e {
 
 enum healthy_e parse_healthy_e (const char *);
 
+
+/*lint -esym(769,  layout_e::_LAYOUT_E_MAX) */
+
+enum layout_e {
+	_LAYOUT_E_INVALID = 0,
+	RING,
+	MAGLEV,
+	JUMP,
+	_LAYOUT_E_MAX
+};
+
+
+enum layout_e parse_layout_e (const char *);
@@ -33,23 +33,168 @@
 #include "cache/cache.h"
 #include "cache/cache_director.h"
 
+#include "vcl.h"
 #include "vrt.h"
-#include "vbm.h"
+#include "vrnd.h"
+#include "vtim.h"
 
 #include "vdir.h"
 
+#include "vcc_if.h"
+
+/*--------------------------------------------------------------------
+ * Things replaced while requests may still be looking at them.  Readers
+ * only hold on to them for the duration of a pick, which never blocks,
+ * so a later replacement frees whatever has been retired for longer
+ * than VDIR_RETIRE_GRACE.  The rest goes when the VCL turns cold.
+ */
+
+#define VDIR_RETIRE_GRACE	5.0
+
+struct vdir_retired {
+	unsigned				magic;
+#define VDIR_RETIRED_MAGIC			0x5b1e0c3d
+	VTAILQ_ENTRY(vdir_retired)		list;
+	const struct vcl			*vcl;
+	double					t_retired;
+	void					*priv;
+	vdir_free_f				*func;
+};
+
+static VTAILQ_HEAD(, vdir_retired) vdir_retired =
+    VTAILQ_HEAD_INITIALIZER(vdir_retired);
+static pthread_mutex_t vdir_retired_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+void
+vdir_retire(VRT_CTX, void *priv, vdir_free_f *func)
+{
+	struct vdir_retired *vr, *vr2;
+	unsigned n = 0;
+	double now;
+
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	AN(ctx->vcl);
+	AN(priv);
+	AN(func);
+	if (ctx->method == VCL_MET_INIT) {
+		func(priv);
+		return;
+	}
+	ALLOC_OBJ(vr, VDIR_RETIRED_MAGIC);
+	AN(vr);
+	vr->vcl = ctx->vcl;
+	vr->priv = priv;
+	vr->func = func;
+	AZ(pthread_mutex_lock(&vdir_retired_mtx));
+	now = VTIM_mono();
+	while (1) {
+		vr2 = VTAILQ_FIRST(&vdir_retired);
+		if (vr2 == NULL || vr2->t_retired + VDIR_RETIRE_GRACE > now)
+			break;
+		CHECK_OBJ(vr2, VDIR_RETIRED_MAGIC);
+		VTAILQ_REMOVE(&vdir_retired, vr2, list);
+		vr2->func(vr2->priv);
+		FREE_OBJ(vr2);
+		n++;
+	}
+	vr->t_retired = now;
+	VTAILQ_INSERT_TAIL(&vdir_retired, vr, list);
+	AZ(pthread_mutex_unlock(&vdir_retired_mtx));
+	if (n > 0)
+		VSL(SLT_Debug, 0, "vdir: freed %u retired", n);
+}
+
+int __match_proto__(vmod_event_f)
+vmod_event(VRT_CTX, struct vmod_priv *priv, enum vcl_event_e e)
+{
+	struct vdir_retired *vr, *vr2;
+
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	(void)priv;
+	if (e != VCL_EVENT_COLD)
+		return (0);
+	AZ(pthread_mutex_lock(&vdir_retired_mtx));
+	VTAILQ_FOREACH_SAFE(vr, &vdir_retired, list, vr2) {
+		CHECK_OBJ_NOTNULL(vr, VDIR_RETIRED_MAGIC);
+		if (vr->vcl != ctx->vcl)
+			continue;
+		VTAILQ_REMOVE(&vdir_retired, vr, list);
+		vr->func(vr->priv);
+		FREE_OBJ(vr);
+	}
+	AZ(pthread_mutex_unlock(&vdir_retired_mtx));
+	return (0);
+}
+
+/*--------------------------------------------------------------------
+ * Backend sets
+ */
+
+static struct vdir_set *
+vdir_set_new(unsigned n)
+{
+	struct vdir_set *vs;
+
+	vs = calloc(1, sizeof *vs +
+	    n * (sizeof *vs->backend + sizeof *vs->weight));
+	AN(vs);
+	vs->magic = VDIR_SET_MAGIC;
+	vs->weight = (void *)(vs + 1);
+	vs->backend = (void *)(vs->weight + n);
+	return (vs);
+}
+
+static void
+vdir_set_free(struct vdir_set *vs)
+{
+
+	CHECK_OBJ_NOTNULL(vs, VDIR_SET_MAGIC);
+	FREE_OBJ(vs);
+}
+
+/*
+ * Replace the current set.  Backends may be picked from the old one
+ * until no request can be looking at it anymore.
+ */
+
+static void
+vdir_set_retired(void *priv)
+{
+	struct vdir_set *vs;
+
+	CAST_OBJ_NOTNULL(vs, priv, VDIR_SET_MAGIC);
+	vdir_set_free(vs);
+}
+
 static void
-vdir_expand(struct vdir *vd, unsigned n)
+vdir_publish(VRT_CTX, struct vdir *vd, struct vdir_set *vs)
 {
+	struct vdir_set *old;
+
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
+	CHECK_OBJ_NOTNULL(vs, VDIR_SET_MAGIC);
 
-	vd->backend = realloc(vd->backend, n * sizeof *vd->backend);
-	AN(vd->backend);
-	vd->weight = realloc(vd->weight, n * sizeof *vd->weight);
-	AN(vd->weight);
-	vd->l_backend = n;
+	old = vd->set;
+	__sync_synchronize();	/* Readers take no lock */
+	vd->set = vs;
+	CHECK_OBJ_NOTNULL(old, VDIR_SET_MAGIC);
+	vdir_retire(ctx, old, vdir_set_retired);
+}
+
+const struct vdir_set *
+vdir_set(const struct vdir *vd)
+{
+	const struct vdir_set *vs;
+
+	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
+	vs = vd->set;
+	CHECK_OBJ_NOTNULL(vs, VDIR_SET_MAGIC);
+	return (vs);
 }
 
+/*--------------------------------------------------------------------*/
+
 void
 vdir_new(struct vdir **vdp, const char *name, const char *vcl_name,
     vdi_healthy_f *healthy, vdi_resolve_f *resolve, void *priv)
@@ -63,7 +208,8 @@ vdir_new(struct vdir **vdp, const char *name, const char *vcl_name,
 	ALLOC_OBJ(vd, VDIR_MAGIC);
 	AN(vd);
 	*vdp = vd;
-	AZ(pthread_rwlock_init(&vd->mtx, NULL));
+	AZ(pthread_mutex_init(&vd->mtx, NULL));
+	vd->set = vdir_set_new(0);
 
 	ALLOC_OBJ(vd->dir, DIRECTOR_MAGIC);
 	AN(vd->dir);
@@ -72,8 +218,6 @@ vdir_new(struct vdir **vdp, const char *name, const char *vcl_name,
 	vd->dir->priv = priv;
 	vd->dir->healthy = healthy;
 	vd->dir->resolve = resolve;
-	vd->vbm = vbit_new(8);
-	AN(vd->vbm);
 }
 
 void
@@ -83,104 +227,105 @@ vdir_delete(struct vdir **vdp)
 
 	TAKE_OBJ_NOTNULL(vd, vdp, VDIR_MAGIC);
 
-	free(vd->backend);
-	free(vd->weight);
-	AZ(pthread_rwlock_destroy(&vd->mtx));
+	vdir_set_free(vd->set);
+	AZ(pthread_mutex_destroy(&vd->mtx));
 	free(vd->dir->vcl_name);
 	FREE_OBJ(vd->dir);
-	vbit_destroy(vd->vbm);
 	FREE_OBJ(vd);
 }
 
 void
-vdir_rdlock(struct vdir *vd)
+vdir_lock(struct vdir *vd)
 {
 	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
-	AZ(pthread_rwlock_rdlock(&vd->mtx));
-}
-
-void
-vdir_wrlock(struct vdir *vd)
-{
-	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
-	AZ(pthread_rwlock_wrlock(&vd->mtx));
+	AZ(pthread_mutex_lock(&vd->mtx));
 }
 
 void
 vdir_unlock(struct vdir *vd)
 {
 	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
-	AZ(pthread_rwlock_unlock(&vd->mtx));
+	AZ(pthread_mutex_unlock(&vd->mtx));
 }
 
 
 unsigned
-vdir_add_backend(struct vdir *vd, VCL_BACKEND be, double weight)
+vdir_add_backend(VRT_CTX, struct vdir *vd, VCL_BACKEND be, double weight)
 {
+	struct vdir_set *os, *vs;
 	unsigned u;
 
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
 	AN(be);
-	vdir_wrlock(vd);
-	if (vd->n_backend >= vd->l_backend)
-		vdir_expand(vd, vd->l_backend + 16);
-	assert(vd->n_backend < vd->l_backend);
-	u = vd->n_backend++;
-	vd->backend[u] = be;
-	vd->weight[u] = weight;
-	vd->total_weight += weight;
+	vdir_lock(vd);
+	os = vd->set;
+	vs = vdir_set_new(os->n_backend + 1);
+	memcpy(vs->backend, os->backend, os->n_backend * sizeof *vs->backend);
+	memcpy(vs->weight, os->weight, os->n_backend * sizeof *vs->weight);
+	u = vs->n_backend = os->n_backend;
+	vs->backend[u] = be;
+	vs->weight[u] = weight;
+	vs->n_backend++;
+	vdir_publish(ctx, vd, vs);
 	vdir_unlock(vd);
 	return (u);
 }
 
 void
-vdir_remove_backend(struct vdir *vd, VCL_BACKEND be, unsigned *cur)
+vdir_remove_backend(VRT_CTX, struct vdir *vd, VCL_BACKEND be, unsigned *cur)
 {
+	struct vdir_set *os, *vs;
 	unsigned u, n;
 
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
 	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
 	if (be == NULL)
 		return;
 	CHECK_OBJ(be, DIRECTOR_MAGIC);
-	vdir_wrlock(vd);
-	for (u = 0; u < vd->n_backend; u++)
-		if (vd->backend[u] == be)
+	vdir_lock(vd);
+	os = vd->set;
+	for (u = 0; u < os->n_backend; u++)
+		if (os->backend[u] == be)
 			break;
-	if (u == vd->n_backend) {
+	if (u == os->n_backend) {
 		vdir_unlock(vd);
 		return;
 	}
-	vd->total_weight -= vd->weight[u];
-	n = (vd->n_backend - u) - 1;
-	memmove(&vd->backend[u], &vd->backend[u+1], n * sizeof(vd->backend[0]));
-	memmove(&vd->weight[u], &vd->weight[u+1], n * sizeof(vd->weight[0]));
-	vd->n_backend--;
+	vs = vdir_set_new(os->n_backend - 1);
+	n = (os->n_backend - u) - 1;
+	memcpy(vs->backend, os->backend, u * sizeof *vs->backend);
+	memcpy(vs->weight, os->weight, u * sizeof *vs->weight);
+	memcpy(&vs->backend[u], &os->backend[u+1], n * sizeof *vs->backend);
+	memcpy(&vs->weight[u], &os->weight[u+1], n * sizeof *vs->weight);
+	vs->n_backend = os->n_backend - 1;
 
 	if (cur) {
-		assert(*cur <= vd->n_backend);
+		assert(*cur <= vs->n_backend);
 		if (u < *cur)
 			(*cur)--;
-		else if (*cur == vd->n_backend)
+		else if (*cur == vs->n_backend)
 			*cur = 0;
 	}
+	vdir_publish(ctx, vd, vs);
 	vdir_unlock(vd);
 }
 
 unsigned
 vdir_any_healthy(struct vdir *vd, const struct busyobj *bo, double *changed)
 {
+	const struct vdir_set *vs;
 	unsigned retval = 0;
 	VCL_BACKEND be;
 	unsigned u;
 	double c;
 
-	CHECK_OBJ_NOTNULL(vd, VDIR_MAGIC);
 	CHECK_OBJ_ORNULL(bo, BUSYOBJ_MAGIC);
-	vdir_rdlock(vd);
+	vs = vdir_set(vd);
 	if (changed != NULL)
 		*changed = 0;
-	for (u = 0; u < vd->n_backend; u++) {
-		be = vd->backend[u];
+	for (u = 0; u < vs->n_backend; u++) {
+		be = vs->backend[u];
 		CHECK_OBJ_NOTNULL(be, DIRECTOR_MAGIC);
 		retval = be->healthy(be, bo, &c);
 		if (changed != NULL && c > *changed)
@@ -188,52 +333,76 @@ vdir_any_healthy(struct vdir *vd, const struct busyobj *bo, double *changed)
 		if (retval)
 			break;
 	}
-	vdir_unlock(vd);
 	return (retval);
 }
 
-static unsigned
-vdir_pick_by_weight(const struct vdir *vd, double w,
-    const struct vbitmap *blacklist)
+VCL_BACKEND
+vdir_pick_be(struct vdir *vd, double w, const struct busyobj *bo)
 {
-	double a = 0.0;
-	VCL_BACKEND be = NULL;
+	const struct vdir_set *vs;
 	unsigned u;
+	double a, tw = 0.0;
+	VCL_BACKEND be = NULL;
 
-	AN(blacklist);
-	for (u = 0; u < vd->n_backend; u++) {
-		be = vd->backend[u];
-		CHECK_OBJ_NOTNULL(be, DIRECTOR_MAGIC);
-		if (vbit_test(blacklist, u))
+	vs = vdir_set(vd);
+
+	unsigned char healthy[vs->n_backend + 1];
+
+	for (u = 0; u < vs->n_backend; u++) {
+		healthy[u] = vs->backend[u]->healthy(vs->backend[u], bo, NULL);
+		if (healthy[u])
+			tw += vs->weight[u];
+	}
+	if (tw == 0.0)
+		return (NULL);
+	w *= tw;
+	for (a = 0.0, u = 0; u < vs->n_backend; u++) {
+		if (!healthy[u])
 			continue;
-		a += vd->weight[u];
+		be = vs->backend[u];
+		a += vs->weight[u];
 		if (w < a)
-			return (u);
+			break;
 	}
-	WRONG("");
+	CHECK_OBJ_NOTNULL(be, DIRECTOR_MAGIC);
+	return (be);
 }
 
+/*--------------------------------------------------------------------
+ * Power of two choices: Of two healthy backends picked at random, take
+ * the one which costs less.  Comparing all of them would send every
+ * request arriving at the same time to the same backend.
+ */
+
 VCL_BACKEND
-vdir_pick_be(struct vdir *vd, double w, const struct busyobj *bo)
+vdir_pick_least(struct vdir *vd, const struct busyobj *bo, vdir_cost_f *cost)
 {
-	unsigned u;
-	double tw = 0.0;
+	const struct vdir_set *vs;
+	unsigned u, n = 0, a, b;
 	VCL_BACKEND be = NULL;
 
-	vdir_wrlock(vd);
-	for (u = 0; u < vd->n_backend; u++) {
-		if (vd->backend[u]->healthy(vd->backend[u], bo, NULL)) {
-			vbit_clr(vd->vbm, u);
-			tw += vd->weight[u];
-		} else
-			vbit_set(vd->vbm, u);
-	}
-	if (tw > 0.0) {
-		u = vdir_pick_by_weight(vd, w * tw, vd->vbm);
-		assert(u < vd->n_backend);
-		be = vd->backend[u];
-		CHECK_OBJ_NOTNULL(be, DIRECTOR_MAGIC);
+	AN(cost);
+	vs = vdir_set(vd);
+
+	unsigned h[vs->n_backend + 1];
+
+	for (u = 0; u < vs->n_backend; u++)
+		if (vs->backend[u]->healthy(vs->backend[u], bo, NULL))
+			h[n++] = u;
+	if (n == 1) {
+		be = vs->backend[h[0]];
+	} else if (n > 1) {
+		a = VRND_RandomTestable() % n;
+		b = VRND_RandomTestable() % (n - 1);
+		if (b >= a)
+			b++;
+		a = h[a];
+		b = h[b];
+		if (cost(vs->backend[b], vs->weight[b]) <
+		    cost(vs->backend[a], vs->weight[a]))
+			a = b;
+		be = vs->backend[a];
 	}
-	vdir_unlock(vd);
+	CHECK_OBJ_ORNULL(be, DIRECTOR_MAGIC);
 	return (be);
 }
@@ -26,29 +26,44 @@
  * SUCH DAMAGE.
  */
 
-struct vbitmap;
+/*
+ * The backends of a director.  Once published a set is never changed,
+ * so that picking a backend takes no lock: Adding or removing a backend
+ * publishes a new set.
+ */
 
-struct vdir {
+struct vdir_set {
 	unsigned				magic;
-#define VDIR_MAGIC				0x99f4b726
-	pthread_rwlock_t			mtx;
+#define VDIR_SET_MAGIC				0x3f0c58e1
 	unsigned				n_backend;
-	unsigned				l_backend;
 	VCL_BACKEND				*backend;
 	double					*weight;
-	double					total_weight;
+};
+
+struct vdir {
+	unsigned				magic;
+#define VDIR_MAGIC				0x99f4b726
+	pthread_mutex_t				mtx;
+	struct vdir_set				*set;
 	struct director				*dir;
-	struct vbitmap				*vbm;
 };
 
+typedef double vdir_cost_f(VCL_BACKEND, double weight);
+typedef void vdir_free_f(void *);
+
+void vdir_retire(VRT_CTX, void *, vdir_free_f *);
 void vdir_new(struct vdir **vdp, const char *name, const char *vcl_name,
     vdi_healthy_f *healthy, vdi_resolve_f *resolve, void *priv);
 void vdir_delete(struct vdir **vdp);
-void vdir_rdlock(struct vdir *vd);
-void vdir_wrlock(struct vdir *vd);
+void vdir_lock(struct vdir *vd);
 void vdir_unlock(struct vdir *vd);
-unsigned vdir_add_backend(struct vdir *, VCL_BACKEND be, double weight);
-void vdir_remove_backend(struct vdir *, VCL_BACKEND be, unsigned *cur);
+const struct vdir_set *vdir_set(const struct vdir *vd);
+unsigned vdir_add_backend(VRT_CTX, struct vdir *, VCL_BACKEND be,
+    double weight);
+void vdir_remove_backend(VRT_CTX, struct vdir *, VCL_BACKEND be,
+    unsigned *cur);
 unsigned vdir_any_healthy(struct vdir *, const struct busyobj *,
     double *changed);
 VCL_BACKEND vdir_pick_be(struct vdir *, double w, const struct busyobj *);
+VCL_BACKEND vdir_pick_least(struct vdir *, const struct busyobj *,
+    vdir_cost_f *);
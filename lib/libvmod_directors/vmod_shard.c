@@ -168,11 +168,14 @@ vmod_shard_clear(VRT_CTX, struct vmod_directors_shard *vshard,
 
 VCL_BOOL __match_proto__(td_directors_shard_reconfigure)
 vmod_shard_reconfigure(VRT_CTX, struct vmod_directors_shard *vshard,
-    struct vmod_priv *priv, VCL_INT replicas, VCL_ENUM alg_s)
+    struct vmod_priv *priv, VCL_INT replicas, VCL_ENUM alg_s,
+    VCL_ENUM layout_s)
 {
 	enum alg_e alg = parse_alg_e(alg_s);
+	enum layout_e layout = parse_layout_e(layout_s);
 
-	return shardcfg_reconfigure(ctx, priv, vshard->shardd, replicas, alg);
+	return shardcfg_reconfigure(ctx, priv, vshard->shardd, replicas, alg,
+	    layout);
 }
 
 static inline uint32_t
@@ -252,6 +252,15 @@ vmod_cache_req_body(VRT_CTX, VCL_BYTES size)
 	return (1);
 }
 
+VCL_BOOL __match_proto__(td_std_spool_req_body)
+vmod_spool_req_body(VRT_CTX, VCL_BYTES size)
+{
+	CHECK_OBJ_NOTNULL(ctx, VRT_CTX_MAGIC);
+	if (size < 0)
+		size = 0;
+	return (VRT_SpoolReqBody(ctx, (size_t)size));
+}
+
 VCL_STRING __match_proto__(td_std_strstr)
 vmod_strstr(VRT_CTX, VCL_STRING s1, VCL_STRING s2)
 {